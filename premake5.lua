@@ -1,5 +1,21 @@
+-- premake5 vs2019 --egl: headless runs use an EGL surfaceless context (Mesa llvmpipe) instead of a hidden window
+--
+-- Linux needs the glfw, freetype and EGL development packages, irrKlang only for sound.
+-- A CI machine without GPU or display builds and renders a scripted session with:
+--   premake5 gmake2 --egl --no-audio
+--   make config=release BreakOut
+--   mkdir -p out && bin/Release/BreakOut --headless 240 --script tools/headless_session.txt --capture 1,60,239 --output out
+-- the captured frames and timings.csv are written to out, headless.h has the script format
+newoption {
+  trigger = "egl",
+  description = "Create the --headless context with EGL, needs the EGL headers and libEGL"
+}
+newoption {
+  trigger = "no-audio",
+  description = "Build without irrKlang, the game runs silent"
+}
+
 workspace "BreakOut"
-  system "Windows"
   architecture "x86_64"
   defines { "GLOBAL" }
   configurations { "Debug", "Release" }
@@ -17,10 +33,33 @@ project "BreakOut"
   includedirs { "OpenGL/Include" }
 
   libdirs { "OpenGL/Libs" }
-  links { "glfw3.lib", 
-          "opengl32.lib", 
-          "irrKlang.lib", 
-          "freetyped.lib" }
+
+  filter "system:windows"
+    links { "glfw3.lib", 
+            "opengl32.lib", 
+            "freetyped.lib" }
+
+  filter { "system:windows", "not options:no-audio" }
+    links { "irrKlang.lib" }
+
+  -- the Linux irrKlang SDK's libIrrKlang.so goes in OpenGL/Libs
+  filter "system:linux"
+    links { "glfw", "freetype", "pthread", "dl" }
+
+  filter { "system:linux", "not options:no-audio" }
+    links { "IrrKlang" }
+
+  filter "options:no-audio"
+    defines { "BREAKOUT_NO_AUDIO" }
+
+  filter "options:egl"
+    defines { "BREAKOUT_EGL" }
+
+  filter { "options:egl", "system:windows" }
+    links { "libEGL.lib" }
+
+  filter { "options:egl", "system:linux" }
+    links { "EGL" }
 
   filter "configurations:Debug"
     defines { "DEBUG" }
@@ -28,4 +67,36 @@ project "BreakOut"
     
   filter "configurations:Release"
     defines { "NDEBUG" }
-    optimize "On"
\ No newline at end of file
+    optimize "On"
+
+-- offline step, run after changing anything in resources/textures:
+--   bin/Release/TextureCook resources/textures/*.png resources/textures/*.jpg
+project "TextureCook"
+  kind "ConsoleApp"
+  language "C++"
+  targetdir "bin/%{cfg.buildcfg}"
+
+  files { "tools/texture_cook.cpp", "OpenGL/Include/image_DXT.c", "OpenGL/Include/image_helper.c" }
+  includedirs { "OpenGL/Include" }
+
+  filter "configurations:Debug"
+    symbols "On"
+
+  filter "configurations:Release"
+    optimize "On"
+
+-- offline step for a packed build, after cooking; LZ4 only where it pays off:
+--   bin/Release/AssetPacker --lz4 assets.pak resources shaders
+project "AssetPacker"
+  kind "ConsoleApp"
+  language "C++"
+  cppdialect "C++17"
+  targetdir "bin/%{cfg.buildcfg}"
+
+  files { "tools/asset_packer.cpp", "src/lz4_block.h", "src/lz4_block.cpp", "src/asset_pack.h" }
+
+  filter "configurations:Debug"
+    symbols "On"
+
+  filter "configurations:Release"
+    optimize "On"
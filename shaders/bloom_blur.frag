@@ -0,0 +1,22 @@
+#version 330 core
+in vec2 TexCoords;
+out vec4 color;
+
+uniform sampler2D image;
+// one texel of the source along the blur axis
+uniform vec2 direction;
+
+// 9-tap gaussian folded into 5 bilinear fetches
+const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+
+void main()
+{
+    vec3 result = texture(image, TexCoords).rgb * weights[0];
+    for(int i = 1; i < 3; i++)
+    {
+        result += texture(image, TexCoords + direction * offsets[i]).rgb * weights[i];
+        result += texture(image, TexCoords - direction * offsets[i]).rgb * weights[i];
+    }
+    color = vec4(result, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 330 core
+in vec2 TexCoords;
+out vec4 color;
+
+uniform sampler2D image;
+// one texel of the source
+uniform vec2  texel;
+// source texels per output pixel and axis, 2 or 4
+uniform float block;
+uniform float threshold;
+
+void main()
+{
+    // the four taps cover the whole block behind the output pixel: at 2 each one hits
+    // a texel centre, at 4 each one sits on a texel corner and filters a 2x2 quad
+    vec2 offset = texel * block * 0.25;
+    vec3 c = texture(image, TexCoords + offset * vec2(-1.0, -1.0)).rgb;
+    c += texture(image, TexCoords + offset * vec2( 1.0, -1.0)).rgb;
+    c += texture(image, TexCoords + offset * vec2(-1.0,  1.0)).rgb;
+    c += texture(image, TexCoords + offset * vec2( 1.0,  1.0)).rgb;
+    c *= 0.25;
+    // keep only what is brighter than the threshold, scaled so the cut-off is soft
+    float brightness = max(c.r, max(c.g, c.b));
+    c *= max(brightness - threshold, 0.0) / max(brightness, 0.0001);
+    color = vec4(c, 1.0);
+}
\ No newline at end of file
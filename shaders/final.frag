@@ -3,44 +3,185 @@ in vec2 TexCoords;
 out vec4 color;
 
 uniform sampler2D scene;
-uniform vec2  offsets[9];
-uniform int     edge_kernel[9];
-uniform float  blur_kernel[9];
+#ifdef BLOOM
+uniform sampler2D bloomHalf;
+uniform sampler2D bloomQuarter;
+uniform float bloomIntensity;
+#endif
 
-uniform bool chaos;
-uniform bool confuse;
-uniform bool shake;
+#ifdef FXAA
+// FXAA is the preset, 1 low, 2 medium, 3 high: more search steps follow longer edges
+#if FXAA == 1
+#define FXAA_SEARCH_STEPS    4
+#define FXAA_SEARCH_STRIDE   2.0
+#define FXAA_EDGE_THRESHOLD  0.25
+#define FXAA_EDGE_MIN        0.0833
+#define FXAA_SUBPIXEL        0.5
+#elif FXAA == 2
+#define FXAA_SEARCH_STEPS    8
+#define FXAA_SEARCH_STRIDE   1.5
+#define FXAA_EDGE_THRESHOLD  0.166
+#define FXAA_EDGE_MIN        0.0625
+#define FXAA_SUBPIXEL        0.75
+#else
+#define FXAA_SEARCH_STEPS    12
+#define FXAA_SEARCH_STRIDE   1.0
+#define FXAA_EDGE_THRESHOLD  0.125
+#define FXAA_EDGE_MIN        0.0312
+#define FXAA_SUBPIXEL        0.75
+#endif
 
-void main()
+float luma(vec3 c)
 {
-    // zero out memory since an out variable is initialized with undefined values by default 
-    color = vec4(0.0f);
-
-    vec3 sample[9];
-    // sample from texture offsets if using convolution matrix
-    if(chaos || shake)
-        for(int i = 0; i < 9; i++)
-            sample[i] = vec3(texture(scene, TexCoords.st + offsets[i]));
-
-    // process effects
-    if(chaos)
-    {           
-        for(int i = 0; i < 9; i++)
-            color += vec4(sample[i] * edge_kernel[i], 0.0f);
-        color.a = 1.0f;
-    }
-    else if(confuse)
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+vec3 fxaa(vec2 uv)
+{
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec3 center = texture(scene, uv).rgb;
+    float lumaM = luma(center);
+    float lumaN = luma(textureOffset(scene, uv, ivec2( 0,  1)).rgb);
+    float lumaS = luma(textureOffset(scene, uv, ivec2( 0, -1)).rgb);
+    float lumaE = luma(textureOffset(scene, uv, ivec2( 1,  0)).rgb);
+    float lumaW = luma(textureOffset(scene, uv, ivec2(-1,  0)).rgb);
+    float lumaMin = min(lumaM, min(min(lumaN, lumaS), min(lumaE, lumaW)));
+    float lumaMax = max(lumaM, max(max(lumaN, lumaS), max(lumaE, lumaW)));
+    float range = lumaMax - lumaMin;
+    // flat areas, which is most of the screen, leave after five fetches
+    if (range < max(FXAA_EDGE_MIN, lumaMax * FXAA_EDGE_THRESHOLD))
+        return center;
+
+    float lumaNE = luma(textureOffset(scene, uv, ivec2( 1,  1)).rgb);
+    float lumaNW = luma(textureOffset(scene, uv, ivec2(-1,  1)).rgb);
+    float lumaSE = luma(textureOffset(scene, uv, ivec2( 1, -1)).rgb);
+    float lumaSW = luma(textureOffset(scene, uv, ivec2(-1, -1)).rgb);
+
+    // sub-pixel aliasing: how much the center stands out from its neighbourhood
+    float average = (2.0 * (lumaN + lumaS + lumaE + lumaW) + lumaNE + lumaNW + lumaSE + lumaSW) / 12.0;
+    float subpixel = smoothstep(0.0, 1.0, clamp(abs(average - lumaM) / range, 0.0, 1.0));
+    subpixel = subpixel * subpixel * FXAA_SUBPIXEL;
+
+    float horizontal = 2.0 * abs(lumaN + lumaS - 2.0 * lumaM) + abs(lumaNE + lumaSE - 2.0 * lumaE) + abs(lumaNW + lumaSW - 2.0 * lumaW);
+    float vertical = 2.0 * abs(lumaE + lumaW - 2.0 * lumaM) + abs(lumaNE + lumaNW - 2.0 * lumaN) + abs(lumaSE + lumaSW - 2.0 * lumaS);
+    bool isHorizontal = horizontal >= vertical;
+
+    // step towards the side of the edge with the larger contrast
+    float pLuma = isHorizontal ? lumaN : lumaE;
+    float nLuma = isHorizontal ? lumaS : lumaW;
+    float stepLength = isHorizontal ? texel.y : texel.x;
+    float oppositeLuma = pLuma;
+    float gradient = abs(pLuma - lumaM);
+    if (abs(nLuma - lumaM) > gradient)
     {
-        color = vec4(1.0 - texture(scene, TexCoords).rgb, 1.0);
+        stepLength = -stepLength;
+        oppositeLuma = nLuma;
+        gradient = abs(nLuma - lumaM);
     }
-    else if(shake)
+
+    // walk along the edge both ways until its luma changes
+    vec2 edgeUV = uv;
+    vec2 edgeStep;
+    if (isHorizontal)
     {
-        for(int i = 0; i < 9; i++)
-            color += vec4(sample[i] * blur_kernel[i], 0.0f);
-        color.a = 1.0f;
+        edgeUV.y += stepLength * 0.5;
+        edgeStep = vec2(texel.x, 0.0);
     }
     else
     {
-        color =  texture(scene, TexCoords);
+        edgeUV.x += stepLength * 0.5;
+        edgeStep = vec2(0.0, texel.y);
     }
+    float edgeLuma = (lumaM + oppositeLuma) * 0.5;
+    float gradientThreshold = gradient * 0.25;
+
+    vec2 pUV = edgeUV + edgeStep;
+    float pDelta = luma(texture(scene, pUV).rgb) - edgeLuma;
+    bool pEnd = abs(pDelta) >= gradientThreshold;
+    for (int i = 0; i < FXAA_SEARCH_STEPS && !pEnd; i++)
+    {
+        pUV += edgeStep * FXAA_SEARCH_STRIDE;
+        pDelta = luma(texture(scene, pUV).rgb) - edgeLuma;
+        pEnd = abs(pDelta) >= gradientThreshold;
+    }
+    vec2 nUV = edgeUV - edgeStep;
+    float nDelta = luma(texture(scene, nUV).rgb) - edgeLuma;
+    bool nEnd = abs(nDelta) >= gradientThreshold;
+    for (int i = 0; i < FXAA_SEARCH_STEPS && !nEnd; i++)
+    {
+        nUV -= edgeStep * FXAA_SEARCH_STRIDE;
+        nDelta = luma(texture(scene, nUV).rgb) - edgeLuma;
+        nEnd = abs(nDelta) >= gradientThreshold;
+    }
+
+    float pDistance = isHorizontal ? pUV.x - uv.x : pUV.y - uv.y;
+    float nDistance = isHorizontal ? uv.x - nUV.x : uv.y - nUV.y;
+    float shortest = min(pDistance, nDistance);
+    bool deltaSign = (pDistance <= nDistance ? pDelta : nDelta) >= 0.0;
+    // only blend on the side of the edge that ends closest, and more so near its end
+    float edgeBlend = deltaSign == (lumaM - edgeLuma >= 0.0) ? 0.0 : 0.5 - shortest / (pDistance + nDistance);
+    float blend = max(subpixel, edgeBlend);
+
+    if (isHorizontal)
+        uv.y += stepLength * blend;
+    else
+        uv.x += stepLength * blend;
+    return texture(scene, uv).rgb;
 }
+#endif
+
+#if defined(CHAOS) || defined(SHAKE)
+const float offset = 1.0 / 300.0;
+const vec2 offsets[9] = vec2[](
+    vec2(-offset,  offset), vec2(0.0,  offset), vec2(offset,  offset),
+    vec2(-offset,  0.0),    vec2(0.0,  0.0),    vec2(offset,  0.0),
+    vec2(-offset, -offset), vec2(0.0, -offset), vec2(offset, -offset)
+);
+#endif
+#ifdef CHAOS
+const float edge_kernel[9] = float[](
+    -1.0, -1.0, -1.0,
+    -1.0,  8.0, -1.0,
+    -1.0, -1.0, -1.0
+);
+#endif
+#ifdef SHAKE
+const float blur_kernel[9] = float[](
+    1.0 / 16.0, 2.0 / 16.0, 1.0 / 16.0,
+    2.0 / 16.0, 4.0 / 16.0, 2.0 / 16.0,
+    1.0 / 16.0, 2.0 / 16.0, 1.0 / 16.0
+);
+#endif
+
+void main()
+{
+#if defined(CHAOS) || defined(SHAKE)
+    // the 9 taps are fetched once and shared by every convolution in this permutation
+    vec3 taps[9];
+    for(int i = 0; i < 9; i++)
+        taps[i] = texture(scene, TexCoords.st + offsets[i]).rgb;
+    vec3 result = vec3(0.0);
+#ifdef CHAOS
+    // edge detection, a blur under it would not be visible so SHAKE only moves the quad
+    for(int i = 0; i < 9; i++)
+        result += taps[i] * edge_kernel[i];
+#else
+    for(int i = 0; i < 9; i++)
+        result += taps[i] * blur_kernel[i];
+#endif
+#else
+#ifdef FXAA
+    vec3 result = fxaa(TexCoords);
+#else
+    vec3 result = texture(scene, TexCoords).rgb;
+#endif
+#endif
+
+#ifdef BLOOM
+    result += (texture(bloomHalf, TexCoords).rgb + texture(bloomQuarter, TexCoords).rgb) * bloomIntensity;
+#endif
+#ifdef CONFUSE
+    result = 1.0 - result;
+#endif
+    color = vec4(result, 1.0);
+}
\ No newline at end of file
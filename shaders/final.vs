@@ -3,34 +3,29 @@ layout (location = 0) in vec4 vertex;
 
 out vec2 TexCoords;
 
-uniform bool  chaos;
-uniform bool  confuse;
-uniform bool  shake;
-uniform float time;
+// built once per combination of CHAOS, CONFUSE, SHAKE, BLOOM and FXAA, see PostProcessor
+// without any of them this is a plain full-screen pass, the bloom passes use it that way
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    float time;
+};
 
 void main()
 {
     gl_Position = vec4(vertex.xy, 0.0f, 1.0f);
 
-    vec2 texture = vertex.zw;
-    if (chaos)
-    {
-        float strength = 0.3;
-        vec2 pos = vec2(texture.x + sin(time) * strength, texture.y + cos(time) * strength);
-        TexCoords = pos;
-    }
-    else if (confuse)
-    {
-        TexCoords = vec2(1.0 - texture.x, 1.0 - texture.y);
-    }
-    else
-    {
-        TexCoords = texture;
-    }
-    if (shake)
-    {
-        float strength = 0.01;
-        gl_Position.x += cos(time * 10) * strength;        
-        gl_Position.y += cos(time * 15) * strength;        
-    }
-}
+    TexCoords = vertex.zw;
+#ifdef CONFUSE
+    TexCoords = vec2(1.0 - TexCoords.x, 1.0 - TexCoords.y);
+#endif
+#ifdef CHAOS
+    float strength = 0.3;
+    TexCoords += vec2(sin(time), cos(time)) * strength;
+#endif
+#ifdef SHAKE
+    float shakeStrength = 0.01;
+    gl_Position.x += cos(time * 10) * shakeStrength;
+    gl_Position.y += cos(time * 15) * shakeStrength;
+#endif
+}
\ No newline at end of file
@@ -1,17 +1,28 @@
 #version 330 core
 layout (location = 0) in vec4 vertex;
+layout (location = 1) in vec2 offset;
+layout (location = 2) in vec4 color;
+layout (location = 3) in float life;
+layout (location = 4) in float emitter;
 
 out vec2 TexCoords;
 out vec4 ParticleColor;
 
-uniform mat4 projection;
-uniform vec2 offset;
-uniform vec4 color;
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    float time;
+};
+uniform float sizes[8];
 
 void main()
 {
-    float scale = 10.0f;
+    float scale = sizes[int(emitter)];
     TexCoords = vertex.zw;
     ParticleColor = color;
-    gl_Position = projection * vec4((vertex.xy * scale) + offset, 0.0, 1.0);
+    // dead particles collapse to a degenerate quad
+    if (life <= 0.0)
+        gl_Position = vec4(0.0);
+    else
+        gl_Position = projection * vec4((vertex.xy * scale) + offset, 0.0, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#version 330 core
+layout (location = 0) in vec2 inPosition;
+layout (location = 1) in vec2 inVelocity;
+layout (location = 2) in vec4 inColor;
+layout (location = 3) in float inLife;
+layout (location = 4) in float inEmitter;
+// this slot's latest spawn: position, inherited velocity, tint and (emitter type, stamp)
+layout (location = 5) in vec2 spawnPosition;
+layout (location = 6) in vec2 spawnVelocity;
+layout (location = 7) in vec3 spawnTint;
+layout (location = 8) in ivec2 spawnInfo;
+
+out vec2 outPosition;
+out vec2 outVelocity;
+out vec4 outColor;
+out float outLife;
+out float outEmitter;
+
+uniform float dt;
+uniform float seed;
+
+// per emitter type: (life, speed, angle, spread), (inherit, jitter, drag, fade), (gravity, color variance, unused)
+uniform vec4 emitterParams0[8];
+uniform vec4 emitterParams1[8];
+uniform vec4 emitterParams2[8];
+uniform vec3 emitterColor[8];
+
+// the slots whose spawn carries this stamp respawn in this update
+uniform int stamp;
+
+float random(float n)
+{
+    return fract(sin(n) * 43758.5453123);
+}
+
+void main()
+{
+    outPosition = inPosition;
+    outVelocity = inVelocity;
+    outColor = inColor;
+    outLife = inLife;
+    outEmitter = inEmitter;
+
+    // emission
+    if (spawnInfo.y == stamp)
+    {
+        int type = spawnInfo.x;
+        vec4 p0 = emitterParams0[type];
+        vec4 p1 = emitterParams1[type];
+        vec4 p2 = emitterParams2[type];
+        float id = float(gl_VertexID);
+        vec2 jitter = vec2(random(id + seed), random(id * 1.37 + seed)) * 2.0 - 1.0;
+        float shade = 1.0 - p2.z + random(id * 2.11 + seed) * 2.0 * p2.z;
+        float angle = p0.z + (random(id * 3.07 + seed) - 0.5) * p0.w;
+        float speed = p0.y * (0.5 + random(id * 4.13 + seed) * 0.5);
+        outPosition = spawnPosition + jitter * p1.y;
+        outVelocity = spawnVelocity * p1.x + vec2(cos(angle), sin(angle)) * speed;
+        outColor = vec4(emitterColor[type] * spawnTint * shade, 1.0);
+        outLife = p0.x;
+        outEmitter = float(type);
+    }
+
+    // integration and death
+    if (outLife > 0.0)
+    {
+        int type = int(outEmitter);
+        vec4 p1 = emitterParams1[type];
+        outLife -= dt;
+        if (outLife > 0.0)
+        {
+            outVelocity += emitterParams2[type].xy * dt;
+            outVelocity *= max(0.0, 1.0 - p1.z * dt);
+            outPosition += outVelocity * dt;
+        }
+        outColor.a -= dt * p1.w;
+    }
+}
\ No newline at end of file
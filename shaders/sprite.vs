@@ -4,7 +4,11 @@ layout (location = 0) in vec4 vertex;
 out vec2 TexCoords;
 
 uniform mat4 model;
-uniform mat4 projection;
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    float time;
+};
 
 void main()
 {
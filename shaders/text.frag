@@ -1,12 +1,40 @@
 #version 330 core
 in vec2 TexCoords;
+in vec3 TextColor;
 out vec4 color;
 
 uniform sampler2D text;
-uniform vec3 textColor;
+
+// signed distance field glyphs: 0.5 is the edge, larger is inside
+uniform bool  sdf;
+uniform float outlineWidth;
+uniform vec4  outlineColor;
+uniform float glowWidth;
+uniform vec4  glowColor;
 
 void main()
 {    
-    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-    color = vec4(textColor, 1.0) * sampled;
+    float value = texture(text, TexCoords).r;
+    if (!sdf)
+    {
+        color = vec4(TextColor, 1.0) * vec4(1.0, 1.0, 1.0, value);
+        return;
+    }
+
+    // anti-aliasing width follows the on-screen size, so every scale stays sharp
+    float smoothing = fwidth(value) * 0.75;
+    float fill = smoothstep(0.5 - smoothing, 0.5 + smoothing, value);
+    vec4 result = vec4(TextColor, fill);
+    if (outlineWidth > 0.0)
+    {
+        float edge = 0.5 - outlineWidth;
+        float outline = smoothstep(edge - smoothing, edge + smoothing, value);
+        result = mix(vec4(outlineColor.rgb, outline * outlineColor.a), vec4(TextColor, 1.0), fill);
+    }
+    if (glowWidth > 0.0)
+    {
+        float glow = smoothstep(0.5 - outlineWidth - glowWidth, 0.5 - outlineWidth, value) * glowColor.a;
+        result = mix(vec4(glowColor.rgb, glow), vec4(result.rgb, 1.0), result.a);
+    }
+    color = result;
 }  
\ No newline at end of file
@@ -16,7 +16,7 @@ public:
 	GLfloat		Duration;
 	GLboolean	Activated;
 
-	PowerUp(std::string type, glm::vec3 color, GLfloat duration, glm::vec2 position, Texture2D texture):
+	PowerUp(std::string type, glm::vec3 color, GLfloat duration, glm::vec2 position, TextureHandle texture):
 		GameObject(position, SIZE, texture, color, VELOCITY), Type(type), Duration(duration), Activated() { }
 };
 
@@ -0,0 +1,213 @@
+#include "asset_pack.h"
+#include "lz4_block.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const unsigned char* mapped = nullptr;
+static size_t mappedSize = 0;
+#ifdef _WIN32
+static HANDLE packFile = INVALID_HANDLE_VALUE;
+static HANDLE packMapping = NULL;
+#endif
+static std::map<std::string, PackRecord> entries;
+// decompressed LZ4 entries, handed out again on the next read
+static std::map<std::string, std::shared_ptr<std::vector<unsigned char>>> expanded;
+static std::mutex packMutex;
+
+static std::string normalize(const std::string& path)
+{
+    std::string result = path;
+    std::replace(result.begin(), result.end(), '\\', '/');
+    while (result.compare(0, 2, "./") == 0)
+        result.erase(0, 2);
+    return result;
+}
+
+static bool mapFile(const char* file)
+{
+#ifdef _WIN32
+    packFile = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (packFile == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(packFile, &size) || size.QuadPart == 0)
+        return false;
+    packMapping = CreateFileMappingA(packFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (packMapping == NULL)
+        return false;
+    mapped = static_cast<const unsigned char*>(MapViewOfFile(packMapping, FILE_MAP_READ, 0, 0, 0));
+    mappedSize = static_cast<size_t>(size.QuadPart);
+    return mapped != nullptr;
+#else
+    int descriptor = open(file, O_RDONLY);
+    if (descriptor < 0)
+        return false;
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+    {
+        close(descriptor);
+        return false;
+    }
+    // the mapping holds its own reference to the file
+    void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (address == MAP_FAILED)
+        return false;
+    mapped = static_cast<const unsigned char*>(address);
+    mappedSize = static_cast<size_t>(info.st_size);
+    return true;
+#endif
+}
+
+static void unmapFile()
+{
+#ifdef _WIN32
+    if (mapped)
+        UnmapViewOfFile(mapped);
+    if (packMapping != NULL)
+        CloseHandle(packMapping);
+    if (packFile != INVALID_HANDLE_VALUE)
+        CloseHandle(packFile);
+    packMapping = NULL;
+    packFile = INVALID_HANDLE_VALUE;
+#else
+    if (mapped)
+        munmap(const_cast<unsigned char*>(mapped), mappedSize);
+#endif
+    mapped = nullptr;
+    mappedSize = 0;
+}
+
+static bool readIndex(const char* file)
+{
+    PackHeader header;
+    if (mappedSize < sizeof(header))
+        return false;
+    std::memcpy(&header, mapped, sizeof(header));
+    if (std::memcmp(header.Magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || header.Version != PACK_VERSION)
+    {
+        std::cout << "ERROR::ASSETPACK: " << file << " is not a version " << PACK_VERSION << " asset pack" << std::endl;
+        return false;
+    }
+    if (header.IndexOffset > mappedSize || header.IndexSize > mappedSize - header.IndexOffset)
+        return false;
+    const unsigned char* cursor = mapped + header.IndexOffset;
+    const unsigned char* end = cursor + header.IndexSize;
+    for (uint32_t i = 0; i < header.Count; ++i)
+    {
+        PackRecord record;
+        if (static_cast<size_t>(end - cursor) < sizeof(record))
+            return false;
+        std::memcpy(&record, cursor, sizeof(record));
+        cursor += sizeof(record);
+        if (static_cast<size_t>(end - cursor) < record.PathLength
+            || record.Offset > mappedSize || record.Size > mappedSize - record.Offset
+            || (!(record.Flags & PACK_LZ4) && record.Size != record.RawSize))
+            return false;
+        entries[std::string(reinterpret_cast<const char*>(cursor), record.PathLength)] = record;
+        cursor += record.PathLength;
+    }
+    return true;
+}
+
+bool AssetPack::Open(const char* file)
+{
+    Close();
+    std::lock_guard<std::mutex> lock(packMutex);
+    if (!mapFile(file))
+    {
+        unmapFile();
+        return false;
+    }
+    if (!readIndex(file))
+    {
+        std::cout << "ERROR::ASSETPACK: Failed to read the index of " << file << std::endl;
+        entries.clear();
+        unmapFile();
+        return false;
+    }
+    return true;
+}
+
+void AssetPack::Close()
+{
+    std::lock_guard<std::mutex> lock(packMutex);
+    entries.clear();
+    expanded.clear();
+    unmapFile();
+}
+
+bool AssetPack::IsOpen()
+{
+    std::lock_guard<std::mutex> lock(packMutex);
+    return mapped != nullptr;
+}
+
+bool AssetPack::Contains(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(packMutex);
+    return entries.count(normalize(path)) > 0;
+}
+
+AssetView AssetPack::Read(const std::string& path)
+{
+    AssetView view;
+    {
+        std::lock_guard<std::mutex> lock(packMutex);
+        std::string name = normalize(path);
+        auto entry = entries.find(name);
+        if (entry != entries.end())
+        {
+            const PackRecord& record = entry->second;
+            if (!(record.Flags & PACK_LZ4))
+            {
+                view.Data = mapped + record.Offset;
+                view.Size = static_cast<size_t>(record.Size);
+                return view;
+            }
+            std::shared_ptr<std::vector<unsigned char>>& buffer = expanded[name];
+            if (!buffer)
+            {
+                std::shared_ptr<std::vector<unsigned char>> raw = std::make_shared<std::vector<unsigned char>>(static_cast<size_t>(record.RawSize));
+                if (!LZ4Decompress(mapped + record.Offset, static_cast<size_t>(record.Size), raw->data(), raw->size()))
+                {
+                    std::cout << "ERROR::ASSETPACK: " << name << " is corrupt" << std::endl;
+                    expanded.erase(name);
+                    return view;
+                }
+                buffer = raw;
+            }
+            view.Owned = buffer;
+            view.Data = buffer->data();
+            view.Size = buffer->size();
+            return view;
+        }
+    }
+
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream)
+        return view;
+    view.Owned = std::make_shared<std::vector<unsigned char>>((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    // an empty file still reads as found
+    static const unsigned char nothing = 0;
+    view.Data = view.Owned->empty() ? &nothing : view.Owned->data();
+    view.Size = view.Owned->size();
+    return view;
+}
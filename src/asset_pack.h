@@ -0,0 +1,64 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The bytes of one asset. Points straight into the mapped pack for stored entries,
+// owns a buffer for LZ4 entries and loose files. Empty (Data null) when not found.
+struct AssetView {
+    const unsigned char* Data;
+    size_t               Size;
+    std::shared_ptr<std::vector<unsigned char>> Owned;
+
+    AssetView() : Data(nullptr), Size(0) { }
+    explicit operator bool() const { return Data != nullptr; }
+    std::string Text() const { return Data ? std::string(reinterpret_cast<const char*>(Data), Size) : std::string(); }
+};
+
+// Pack layout, little endian, written by tools/asset_packer.cpp:
+//   PackHeader | entry data, each 16 byte aligned | index at IndexOffset
+// The index is Count times a PackRecord followed by PathLength bytes of path.
+const char PACK_MAGIC[4] = { 'B', 'K', 'P', 'K' };
+const uint32_t PACK_VERSION = 1;
+const uint32_t PACK_LZ4 = 1;
+
+struct PackHeader {
+    char     Magic[4];
+    uint32_t Version;
+    uint32_t Count;
+    uint32_t IndexSize;
+    uint64_t IndexOffset;
+};
+
+struct PackRecord {
+    uint64_t Offset;
+    // bytes in the pack, and after decompression
+    uint64_t Size;
+    uint64_t RawSize;
+    uint32_t Flags;
+    uint32_t PathLength;
+};
+
+// Assets by the relative path the game names them with ("shaders/sprite.vs"). With
+// a pack open its entries are used first, anything it lacks is read as a loose file.
+class AssetPack
+{
+public:
+    // maps the pack; false (and loose files only) when it is missing or malformed
+    static bool Open(const char* file);
+    // views into the pack are invalid afterwards
+    static void Close();
+    static bool IsOpen();
+    static bool Contains(const std::string& path);
+    // thread safe; an LZ4 entry is decompressed once and kept until Close
+    static AssetView Read(const std::string& path);
+
+private:
+    AssetPack() { }
+};
+
+#endif
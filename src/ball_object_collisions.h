@@ -16,7 +16,7 @@ public:
 	GLboolean Sticky = GL_FALSE, PassThrough = GL_FALSE;
 
 	BallObject();
-	BallObject(glm::vec2 pos, float radius, glm::vec2 velocity, Texture2D sprite);
+	BallObject(glm::vec2 pos, float radius, glm::vec2 velocity, TextureHandle sprite);
 
 	glm::vec2 Move(float dt, unsigned int window_width);
 
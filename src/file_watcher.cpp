@@ -0,0 +1,95 @@
+#include "file_watcher.h"
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// between two scans of the modification times when polling
+const std::chrono::milliseconds POLL_INTERVAL(250);
+
+static std::time_t modified(const std::string& file)
+{
+    struct stat info;
+    return stat(file.c_str(), &info) == 0 ? info.st_mtime : 0;
+}
+
+FileWatcher::FileWatcher()
+    : inotify(-1), lastScan(Clock::now())
+{
+#ifdef __linux__
+    this->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if (this->inotify >= 0)
+        close(this->inotify);
+#endif
+}
+
+void FileWatcher::Watch(const std::string& file)
+{
+    if (!this->files.insert(file).second)
+        return;
+    this->stamps[file] = modified(file);
+#ifdef __linux__
+    if (this->inotify < 0)
+        return;
+    size_t slash = file.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : file.substr(0, slash);
+    // editors either write in place or rename a temporary over the file
+    int watch = inotify_add_watch(this->inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch >= 0)
+        this->directories[watch] = directory;
+#endif
+}
+
+std::vector<std::string> FileWatcher::Changed()
+{
+    if (this->inotify < 0)
+        return this->poll();
+
+    std::set<std::string> changed;
+#ifdef __linux__
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(this->inotify, buffer, sizeof(buffer))) > 0)
+    {
+        for (char* cursor = buffer; cursor < buffer + length; )
+        {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(cursor);
+            cursor += sizeof(struct inotify_event) + event->len;
+            if (event->len == 0)
+                continue;
+            const std::string& directory = this->directories[event->wd];
+            std::string file = directory == "." ? std::string(event->name) : directory + "/" + event->name;
+            if (this->files.count(file))
+                changed.insert(file);
+        }
+    }
+#endif
+    return std::vector<std::string>(changed.begin(), changed.end());
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+    std::vector<std::string> changed;
+    Clock::time_point now = Clock::now();
+    if (now - this->lastScan < POLL_INTERVAL)
+        return changed;
+    this->lastScan = now;
+    for (const std::string& file : this->files)
+    {
+        std::time_t stamp = modified(file);
+        if (stamp == this->stamps[file])
+            continue;
+        this->stamps[file] = stamp;
+        changed.push_back(file);
+    }
+    return changed;
+}
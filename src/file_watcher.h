@@ -0,0 +1,36 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Reports files that were written. On Linux inotify watches their directories,
+// elsewhere (or when inotify is unavailable) modification times are polled.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    void Watch(const std::string& file);
+    // the watched files written since the last call, never blocks
+    std::vector<std::string> Changed();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    std::set<std::string> files;
+    // inotify descriptor, -1 when polling
+    int inotify;
+    // watch descriptor to the directory it watches
+    std::map<int, std::string> directories;
+    std::map<std::string, std::time_t> stamps;
+    Clock::time_point lastScan;
+
+    std::vector<std::string> poll();
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <thread>
+
+#include <GLFW/glfw3.h>
+
+const std::chrono::microseconds MIN_SLACK(500);
+const std::chrono::microseconds MAX_SLACK(4000);
+
+FramePacer::FramePacer(double fps, bool vsync)
+    : fps(0.0), vsync(vsync), interval(Clock::duration::zero()), next(Clock::now()), slack(std::chrono::milliseconds(2))
+{
+    this->SetTargetFPS(fps);
+}
+
+void FramePacer::SetTargetFPS(double fps)
+{
+    this->fps = std::max(fps, 0.0);
+    this->interval = this->fps > 0.0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / this->fps))
+        : Clock::duration::zero();
+    this->Restart();
+}
+
+double FramePacer::TargetFPS() const
+{
+    return this->fps;
+}
+
+void FramePacer::SetVSync(bool vsync)
+{
+    this->vsync = vsync;
+    glfwSwapInterval(vsync ? 1 : 0);
+}
+
+bool FramePacer::VSync() const
+{
+    return this->vsync;
+}
+
+void FramePacer::Wait()
+{
+    if (this->interval == Clock::duration::zero())
+        return;
+    Clock::time_point now = Clock::now();
+    this->next += this->interval;
+    // more than a frame behind (a hitch, a drag of the window): drop the debt instead of racing to repay it
+    if (this->next + this->interval < now)
+        this->next = now;
+
+    if (this->next - now > this->slack)
+    {
+        Clock::duration request = this->next - now - this->slack;
+        std::this_thread::sleep_for(request);
+        Clock::duration overslept = Clock::now() - now - request;
+        // grow at once on a late wake up, shrink slowly while sleeps are accurate
+        this->slack = std::max(overslept, this->slack - this->slack / 64);
+        this->slack = std::min(std::max(this->slack, Clock::duration(MIN_SLACK)), Clock::duration(MAX_SLACK));
+    }
+    while (Clock::now() < this->next)
+        std::this_thread::yield();
+}
+
+void FramePacer::Restart()
+{
+    this->next = Clock::now();
+}
@@ -0,0 +1,35 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+
+// Caps the frame rate and owns the swap interval. Waiting sleeps for most of the
+// frame and spins the rest, the OS sleep is too coarse to hit the deadline alone.
+class FramePacer
+{
+public:
+    // fps 0 leaves pacing to vsync, or to nothing with vsync off
+    FramePacer(double fps = 0.0, bool vsync = true);
+
+    void SetTargetFPS(double fps);
+    double TargetFPS() const;
+    // needs the GL context current on this thread
+    void SetVSync(bool vsync);
+    bool VSync() const;
+
+    // after each swap: blocks until the next frame is due
+    void Wait();
+    // after blocking on events: the next deadline counts from now
+    void Restart();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    double fps;
+    bool vsync;
+    Clock::duration interval;
+    Clock::time_point next;
+    // time left to spin instead of sleep, follows the worst recent oversleep
+    Clock::duration slack;
+};
+
+#endif
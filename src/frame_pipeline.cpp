@@ -0,0 +1,68 @@
+#include "frame_pipeline.h"
+
+FramePipeline::FramePipeline(Game& game)
+    : game(game), recording(0), dt(0.0f), busy(false), quit(false)
+{
+    this->worker = std::thread(&FramePipeline::run, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->done.wait(lock, [this]() { return !this->busy; });
+        this->quit = true;
+    }
+    this->wake.notify_one();
+    this->worker.join();
+}
+
+void FramePipeline::Frame(float dt, const bool* keys, bool* released)
+{
+    unsigned int submit;
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->done.wait(lock, [this]() { return !this->busy; });
+        // the worker is idle, game state and input can be touched safely until it is woken
+        for (unsigned int key = 0; key < 1024; ++key)
+        {
+            this->game.Keys[key] = keys[key];
+            if (released[key])
+            {
+                this->game.KeysProcessed[key] = false;
+                released[key] = false;
+            }
+        }
+        submit = this->recording;
+        this->recording = 1 - this->recording;
+        this->lists[this->recording].Clear();
+        this->dt = dt;
+        this->busy = true;
+    }
+    this->wake.notify_one();
+
+    this->game.Render(this->lists[submit]);
+}
+
+void FramePipeline::run()
+{
+    while (true)
+    {
+        unsigned int list;
+        float dt;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [this]() { return this->busy || this->quit; });
+            if (this->quit)
+                return;
+            list = this->recording;
+            dt = this->dt;
+        }
+        this->game.Simulate(dt, this->lists[list]);
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->busy = false;
+        }
+        this->done.notify_one();
+    }
+}
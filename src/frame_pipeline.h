@@ -0,0 +1,38 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "game.h"
+#include "render_commands.h"
+
+// Runs Game::Simulate for frame N on a worker thread while the GL thread draws
+// frame N-1 from the other command list, so a frame costs max(sim, submit).
+class FramePipeline
+{
+public:
+    FramePipeline(Game& game);
+    ~FramePipeline();
+
+    // GL thread, once per frame: waits for the frame being simulated, hands the worker
+    // this frame's input, then draws the finished frame while the next one simulates.
+    // keys is the current key state, released the keys let go since the last call.
+    void Frame(float dt, const bool* keys, bool* released);
+
+private:
+    Game& game;
+    RenderCommandList lists[2];
+    // list the worker records into, the other one is submitted
+    unsigned int recording;
+    float dt;
+    bool busy, quit;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::thread worker;
+
+    void run();
+};
+
+#endif
@@ -1,8 +1,11 @@
 #include <algorithm>
-#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
 
 #include "game.h"
 #include "resource_manager.h"
+#include "asset_pack.h"
 #include "sprite_renderer.h"
 #include "game_object.h"
 #include "ball_object_collisions.h"
@@ -12,17 +15,85 @@
 
 // ıȾͷļ
 #include "text_renderer.h"
-// Ƶ
+#include "gl_state.h"
+#include "render_graph.h"
+#include "quality_governor.h"
+// Ƶ, BREAKOUT_NO_AUDIOʱʹ
+#ifndef BREAKOUT_NO_AUDIO
 #include <irrKlang/irrKlang.h>
+#endif
+
+// ɫ, ڹϣ
+constexpr ResourceId SPRITE_SHADER("sprite");
+constexpr ResourceId PARTICLE_SHADER("particle");
+constexpr ResourceId PARTICLE_UPDATE_SHADER("particle_update");
+constexpr ResourceId PADDLE_TEXTURE("paddle");
+constexpr ResourceId FACE_TEXTURE("face");
+constexpr ResourceId PARTICLE_TEXTURE("particle");
+constexpr ResourceId SPEED_TEXTURE("tex_speed");
+constexpr ResourceId STICKY_TEXTURE("tex_sticky");
+constexpr ResourceId PASSTHROUGH_TEXTURE("tex_passthrough");
+constexpr ResourceId INCREASE_TEXTURE("tex_increase");
+constexpr ResourceId CONFUSE_TEXTURE("tex_confuse");
+constexpr ResourceId CHAOS_TEXTURE("tex_chaos");
 SpriteRenderer* Renderer;
 GameObject* Player;
 BallObject* Ball;
 ParticleGenerator* Particles;
-PostProcessor* Effects;
+PostProcessor* PostEffects;
+// ģ߳޸, ÿ֡бȾ߳
+PostSettings Effects = { false, false, false, true, FXAA_OFF, 4 };
+// ģ߳¼Ƶб
+RenderCommandList* Commands;
+// ڲȾֱֱʵı, ģ߳޸
+float RenderScale = 1.0f;
+// F3صĵϢ: passGPUʱ״̬, ģ߳޸
+bool ShowTimings = false;
+// GL߳: ǰ֡СʵЧȾ
+unsigned int FramebufferWidth, FramebufferHeight;
+float AppliedRenderScale = 1.0f;
+// ģ߳: ۼƵģʱ, ЧԴΪ׼, ǽ޹
+float SimulationTime = 0.0f;
+// GL߳: ֹĻ, С֡
+bool LastFrameStatic = false;
+unsigned int CacheFBO = 0, CacheTexture = 0;
+unsigned int CacheWidth = 0, CacheHeight = 0;
+RenderGraph* Graph;
+// Ӧ: ֡ʱ䳬Ԥʱ𼶽ͻ, Լ֮Ч
+QualityGovernor Governor;
+// GL߳һ֡RenderCPUʱ()
+float RenderTime = 0.0f;
+// ÿ֡ҪƵı, ֻһ
+TextureHandle BackgroundTexture;
+#ifdef BREAKOUT_NO_AUDIO
+void PlayAudio(const char* file, bool loop)
+{
+}
+#else
 // Ƶ
 irrklang::ISoundEngine* SoundEngine = irrklang::createIrrKlangDevice();
+// ûƵ豸(CI)ʱʧ, 
+void PlayAudio(const char* file, bool loop)
+{
+    if (!SoundEngine)
+        return;
+    // ԴеЧڴעһ, ֮ļ
+    irrklang::ISoundSource* source = SoundEngine->getSoundSource(file, false);
+    if (!source && AssetPack::Contains(file))
+    {
+        AssetView data = AssetPack::Read(file);
+        source = SoundEngine->addSoundSourceFromMemory(const_cast<unsigned char*>(data.Data), static_cast<irrklang::ik_s32>(data.Size), file);
+    }
+    if (source)
+        SoundEngine->play2D(source, loop);
+    else
+        SoundEngine->play2D(file, loop);
+}
+#endif
 // ıȾ
 TextRenderer* Text;
+// HUDı, ݲʱŰ
+TextObject LivesText, LevelText, MoveText, PauseText, MenuText, WinText, QuitText;
 float ShakeTime = 0.0f;
 // Ϸͣ
 bool GamePause = false;
@@ -35,41 +106,72 @@ Game::Game(unsigned int width, unsigned int height)
 
 Game::~Game() 
 {
-	delete Renderer;
+    this->Shutdown();
+}
+
+void Game::Shutdown()
+{
+    // ȷſɫ, ResourceManager::ClearŲᱨй©
+    delete Renderer;
     delete Player;
     delete Ball;
     delete Particles;
-    delete Effects;
+    delete PostEffects;
+    delete Graph;
+    delete Text;
+    Renderer = nullptr;
+    Player = nullptr;
+    Ball = nullptr;
+    Particles = nullptr;
+    PostEffects = nullptr;
+    Graph = nullptr;
+    Text = nullptr;
+    this->Levels.clear();
+    this->PowerUps.clear();
+    BackgroundTexture = TextureHandle();
+    if (CacheFBO != 0)
+    {
+        glDeleteFramebuffers(1, &CacheFBO);
+        glDeleteTextures(1, &CacheTexture);
+        CacheFBO = CacheTexture = 0;
+        GLState::Invalidate();
+    }
 }
 
 void Game::Init()
 {   
     ResourceManager::LoadShader("shaders/sprite.vs", "shaders/sprite.frag", nullptr, "sprite");
     ResourceManager::LoadShader("shaders/particle.vs", "shaders/particle.frag", nullptr, "particle");
-    ResourceManager::LoadShader("shaders/final.vs", "shaders/final.frag", nullptr, "postprocessing");
-
-    glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(this->Width), static_cast<float>(this->Height), 0.0f, -1.0f, 1.0f);
-    ResourceManager::GetShader("sprite").Use().SetInteger("image", 0);
-    ResourceManager::GetShader("sprite").SetMatrix4("projection", projection);
-    ResourceManager::GetShader("sprite").SetVector3f("spriteColor", glm::vec3(0.0f, 1.0f, 1.0f));
-    ResourceManager::GetShader("particle").Use().SetInteger("sprite", 0);
-    ResourceManager::GetShader("particle").SetMatrix4("projection", projection);
-    Shader shader = ResourceManager::GetShader("sprite");
+    const char* particleVaryings[] = { "outPosition", "outVelocity", "outColor", "outLife", "outEmitter" };
+    ResourceManager::LoadFeedbackShader("shaders/particle_update.vs", particleVaryings, 5, "particle_update");
+    // ֵĳҲһύ, ɲб; 캯ͬLoadShaderֱȡЩ
+    ResourceManager::LoadShader("shaders/final.vs", "shaders/bloom_extract.frag", nullptr, "bloom_extract");
+    ResourceManager::LoadShader("shaders/final.vs", "shaders/bloom_blur.frag", nullptr, "bloom_blur");
+    ResourceManager::LoadShader("shaders/text.vs", "shaders/text.frag", nullptr, "text");
+
+    // ͶӰʱɫFrame uniformṩ, ÿ֡ϴһ
+    ResourceManager::GetShader(SPRITE_SHADER).Use().SetInteger("image", 0);
+    ResourceManager::GetShader(SPRITE_SHADER).SetVector3f("spriteColor", glm::vec3(0.0f, 1.0f, 1.0f));
+    ResourceManager::GetShader(PARTICLE_SHADER).Use().SetInteger("sprite", 0);
+    Shader shader = ResourceManager::GetShader(SPRITE_SHADER);
     Renderer = new SpriteRenderer(shader);
-    Effects = new PostProcessor(ResourceManager::GetShader("postprocessing"), this->Width, this->Height);
-
-    ResourceManager::LoadTexture("resources/textures/awesomeface.png", true, "face");
-    ResourceManager::LoadTexture("resources/textures/background.jpg", false, "background");
-    ResourceManager::LoadTexture("resources/textures/block.png", false, "block");
-    ResourceManager::LoadTexture("resources/textures/block_solid.png", false, "block_solid");
-    ResourceManager::LoadTexture("resources/textures/paddle.png", true, "paddle");
-    ResourceManager::LoadTexture("resources/textures/particle.png", true, "particle");
-    ResourceManager::LoadTexture("resources/textures/powerup_chaos.png", true, "tex_chaos");
-    ResourceManager::LoadTexture("resources/textures/powerup_confuse.png", true, "tex_confuse");
-    ResourceManager::LoadTexture("resources/textures/powerup_increase.png", true, "tex_increase");
-    ResourceManager::LoadTexture("resources/textures/powerup_passthrough.png", true, "tex_passthrough");
-    ResourceManager::LoadTexture("resources/textures/powerup_speed.png", true, "tex_speed");
-    ResourceManager::LoadTexture("resources/textures/powerup_sticky.png", true, "tex_sticky");
+    PostEffects = new PostProcessor("shaders/final.vs", "shaders/final.frag");
+    Graph = new RenderGraph(this->Width, this->Height);
+    this->Resize(this->Width, this->Height);
+
+    // ̳߳вн, ֮ÿ֡ͨPBOϴ, ʱȡļļ֮
+    ResourceManager::LoadTextureAsync("resources/textures/awesomeface.png", true, "face");
+    BackgroundTexture = ResourceManager::LoadTextureAsync("resources/textures/background.jpg", false, "background");
+    ResourceManager::LoadTextureAsync("resources/textures/block.png", false, "block");
+    ResourceManager::LoadTextureAsync("resources/textures/block_solid.png", false, "block_solid");
+    ResourceManager::LoadTextureAsync("resources/textures/paddle.png", true, "paddle");
+    ResourceManager::LoadTextureAsync("resources/textures/particle.png", true, "particle");
+    ResourceManager::LoadTextureAsync("resources/textures/powerup_chaos.png", true, "tex_chaos");
+    ResourceManager::LoadTextureAsync("resources/textures/powerup_confuse.png", true, "tex_confuse");
+    ResourceManager::LoadTextureAsync("resources/textures/powerup_increase.png", true, "tex_increase");
+    ResourceManager::LoadTextureAsync("resources/textures/powerup_passthrough.png", true, "tex_passthrough");
+    ResourceManager::LoadTextureAsync("resources/textures/powerup_speed.png", true, "tex_speed");
+    ResourceManager::LoadTextureAsync("resources/textures/powerup_sticky.png", true, "tex_sticky");
 
     GameLevel one;
     one.Load("resources/levels/one.lvl", this->Width, this->Height / 2);
@@ -87,23 +189,44 @@ void Game::Init()
     this->Level = 0;
 
     glm::vec2 playerPos = glm::vec2(this->Width / 2.0f - PLAYER_SIZE.x / 2.0f, this->Height - PLAYER_SIZE.y);
-    Player = new GameObject(playerPos, PLAYER_SIZE, ResourceManager::GetTexture("paddle"));
+    Player = new GameObject(playerPos, PLAYER_SIZE, ResourceManager::GetTexture(PADDLE_TEXTURE));
 
     glm::vec2 ballPos = playerPos + glm::vec2(PLAYER_SIZE.x / 2.0f - BALL_RADIUS, -BALL_RADIUS * 2.0f);
-    Ball = new BallObject(ballPos, BALL_RADIUS, INITIAL_BALL_VELOCITY, ResourceManager::GetTexture("face"));
+    Ball = new BallObject(ballPos, BALL_RADIUS, INITIAL_BALL_VELOCITY, ResourceManager::GetTexture(FACE_TEXTURE));
 
+    // ĬGPUģ(任)ɫʱ˻CPU
     Particles = new ParticleGenerator(
-        ResourceManager::GetShader("particle"),
-        ResourceManager::GetTexture("particle"),
-        500
+        ResourceManager::GetShader(PARTICLE_SHADER),
+        ResourceManager::GetShader(PARTICLE_UPDATE_SHADER),
+        ResourceManager::GetTexture(PARTICLE_TEXTURE),
+        2000
     );
+    // зͬһӳ, ļ
+    Particles->LoadEmitters("resources/particles/emitters.txt");
 
     // ȡƵ
-    SoundEngine->play2D("resources/audio/breakout.mp3", true);
+    PlayAudio("resources/audio/breakout.mp3", true);
 
     // ʼıȾ
-    Text = new TextRenderer(this->Width, this->Height);
-    Text->Load("resources/fonts/OCRAEXT.TTF", 24);
+    Text = new TextRenderer();
+    // 볡: ͬһͼ, ֧ߺⷢ
+    Text->Load("resources/fonts/OCRAEXT.TTF", 24, true);
+#ifdef _WIN32
+    // ĵȷASCIIַʹϵͳ(΢ź), ״ʹʱŹդ
+    Text->AddFallbackFont("C:/Windows/Fonts/msyh.ttc");
+#endif
+    LivesText = TextObject(5.0f, 5.0f);
+    LevelText = TextObject(5.0f, 25.0f);
+    MoveText = TextObject(5.0f, 45.0f);
+    MoveText.SetText("Move:A&D");
+    PauseText = TextObject(5.0f, 65.0f);
+    PauseText.SetText("Pause:T");
+    MenuText = TextObject(250.0f, this->Height / 2.0f);
+    MenuText.SetText("Press ENTER to start");
+    WinText = TextObject(320.0f, this->Height / 2.0f - 20.0f, 1.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+    WinText.SetText("You WON!!!");
+    QuitText = TextObject(280.0f, this->Height / 2.0f, 1.0f, glm::vec3(1.0f, 1.0f, 0.0f));
+    QuitText.SetText("Press ESC to quit");
 
     // ʼֵ
     this->Lives = 40;
@@ -115,13 +238,13 @@ void Game::Update(float dt)
         Ball->Move(dt, this->Width);
         this->DoCollisions();
         this->UpdatePowerUps(dt);
-        Particles->Update(dt, *Ball, 2, glm::vec2(Ball->Radius / 2.0f));
+        Commands->Emit("ball_trail", Ball->Position + glm::vec2(Ball->Radius / 2.0f), Ball->Velocity);
 
         if (ShakeTime > 0.0f)
         {
             ShakeTime -= dt;
             if (ShakeTime <= 0.0f)
-                Effects->Shake = false;
+                Effects.Shake = false;
         }
 
         // СĻ·()
@@ -146,7 +269,7 @@ void Game::Update(float dt)
             else {
                 this->ResetLevel();
                 this->ResetPlayer();
-                Effects->Chaos = true;
+                Effects.Chaos = true;
                 this->State = GAME_WIN;
             }
         }
@@ -219,62 +342,264 @@ void Game::ProcessInput(float dt)
         //if (this->Keys[GLFW_KEY_ENTER])
         //{
         //    this->KeysProcessed[GLFW_KEY_ENTER] = true;
-        //    Effects->Chaos = false;
+        //    Effects.Chaos = false;
         //    this->State = GAME_MENU;
         //}
     }
+
+    // Bط
+    if (this->Keys[GLFW_KEY_B] && !this->KeysProcessed[GLFW_KEY_B])
+    {
+        this->KeysProcessed[GLFW_KEY_B] = true;
+        Effects.Bloom = !Effects.Bloom;
+    }
+
+    // FѭлFXAAλ ///
+    if (this->Keys[GLFW_KEY_F] && !this->KeysProcessed[GLFW_KEY_F])
+    {
+        this->KeysProcessed[GLFW_KEY_F] = true;
+        Effects.FXAA = static_cast<FXAAPreset>((Effects.FXAA + 1) % (FXAA_HIGH + 1));
+    }
+
+    // [ ]ڲȾ 0.5 - 2.0, 1ʱŴ, 1ʱ
+    if (this->Keys[GLFW_KEY_LEFT_BRACKET] && !this->KeysProcessed[GLFW_KEY_LEFT_BRACKET])
+    {
+        this->KeysProcessed[GLFW_KEY_LEFT_BRACKET] = true;
+        RenderScale = std::max(0.5f, RenderScale - 0.25f);
+    }
+    if (this->Keys[GLFW_KEY_RIGHT_BRACKET] && !this->KeysProcessed[GLFW_KEY_RIGHT_BRACKET])
+    {
+        this->KeysProcessed[GLFW_KEY_RIGHT_BRACKET] = true;
+        RenderScale = std::min(2.0f, RenderScale + 0.25f);
+    }
+
+    // F3صϢ
+    if (this->Keys[GLFW_KEY_F3] && !this->KeysProcessed[GLFW_KEY_F3])
+    {
+        this->KeysProcessed[GLFW_KEY_F3] = true;
+        ShowTimings = !ShowTimings;
+    }
+
+    // MѭлMSAA 0/2/4/8
+    if (this->Keys[GLFW_KEY_M] && !this->KeysProcessed[GLFW_KEY_M])
+    {
+        this->KeysProcessed[GLFW_KEY_M] = true;
+        Effects.Samples = Effects.Samples == 0 ? 2 : (Effects.Samples * 2) % 16;
+    }
 }
 
-void Game::Render()
+void Game::Simulate(float dt, RenderCommandList& frame)
 {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Commands = &frame;
+    this->ProcessInput(dt);
+    this->Update(dt);
+
+    // ֻ¼ƻ, κGL
     if (this->State == GAME_ACTIVE || this->State == GAME_MENU || this->State == GAME_WIN)
     {
-        Effects->BeginRender();
-
-        Texture2D texture = ResourceManager::GetTexture("background");
-        Renderer->DrawSprite(texture, glm::vec2(0.0f, 0.0f), glm::vec2(this->Width, this->Height), 0.0f);
-        this->Levels[this->Level].Draw(*Renderer);
+        frame.DrawSprite(BackgroundTexture, glm::vec2(0.0f, 0.0f), glm::vec2(this->Width, this->Height), 0.0f);
+        this->Levels[this->Level].Draw(frame);
 
-        Player->Draw(*Renderer);
+        Player->Draw(frame);
 
         for (PowerUp& powerUp : this->PowerUps)
             if (!powerUp.Destroyed)
-                powerUp.Draw(*Renderer);
+                powerUp.Draw(frame);
 
-        Particles->Draw();
+        frame.ParticleLayer = static_cast<unsigned int>(frame.Sprites.size());
 
-        Ball->Draw(*Renderer);
-
-        Effects->EndRender();
+        Ball->Draw(frame);
+    }
+    SimulationTime += dt;
+    frame.ParticleTime = GamePause ? 0.0f : dt;
+    frame.Time = SimulationTime;
+    frame.Post = Effects;
+    frame.RenderScale = RenderScale;
+    frame.Overlay = ShowTimings;
+    frame.State = this->State;
+    frame.Lives = this->Lives;
+    frame.Level = this->Level;
+    // ˵, ʤͣʱһǰ仯(ʤchaosֹ֮ͣ)
+    frame.Static = GamePause || this->State == GAME_MENU || this->State == GAME_WIN;
+    frame.Recorded = true;
+    Commands = nullptr;
+    frame.SimulateTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-        Effects->Render(glfwGetTime());
+void Game::Render(const RenderCommandList& frame)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    GLState::BeginFrame();
+    // ѽɵʼϴ, ϴǰΪɫ; ڼʱ滹仯, 㾲ֹ
+    unsigned int loading = ResourceManager::UploadTextures();
+    LastFrameStatic = frame.Recorded && frame.Static && loading == 0;
+    if (!frame.Recorded)
+        return;
+    FrameUniforms uniforms = {};
+    uniforms.Projection = glm::ortho(0.0f, static_cast<float>(this->Width), static_cast<float>(this->Height), 0.0f, -1.0f, 1.0f);
+    uniforms.Time = frame.Time;
+    Shader::SetFrameUniforms(uniforms);
+
+    for (const EmitCommand& emit : frame.Emits)
+        Particles->Emit(emit.Emitter, emit.Position, emit.Velocity, emit.Tint);
+    // ģȾ, һ֡; ֹֻڵȴ, 
+    Governor.SetSettings(frame.RenderScale, frame.Post.Samples, frame.Post.Bloom);
+    if (!frame.Static && Governor.Update(std::max(frame.SimulateTime, RenderTime), Graph->FrameTime))
+        Particles->SetBudget(static_cast<unsigned int>(Particles->Capacity() * Governor.Limits().ParticleShare));
+    const QualityLimits& limits = Governor.Limits();
+    if (frame.ParticleTime > 0.0f)
+        Particles->Update(frame.ParticleTime);
+    PostSettings post = frame.Post;
+    post.Samples = std::min(post.Samples, limits.Samples);
+    PostEffects->Apply(post);
+    PostEffects->BloomDivisor = limits.BloomDivisor;
+    float renderScale = std::min(frame.RenderScale, limits.RenderScale);
+    if (renderScale != AppliedRenderScale)
+    {
+        AppliedRenderScale = renderScale;
+        this->Resize(FramebufferWidth, FramebufferHeight);
+    }
 
-        std::stringstream ss; 
-        ss << this->Lives;
-        Text->RenderText("Lives:" + ss.str(), 5.0f, 5.0f, 1.0f);
-        std::stringstream curLevel;
-        curLevel << (this->Level + 1) << "/" << "4";
-        Text->RenderText("Level:" + curLevel.str(), 5.0f, 25.0f, 1.0f);
-        Text->RenderText("Move:A&D", 5.0f, 45.0f, 1.0f);
-        Text->RenderText("Pause:T", 5.0f, 65.0f, 1.0f);
+    // ÿ֡ؽȾͼ: pass, RenderGraph, ޳passʱȾĿ
+    Graph->Reset();
+    GameState state = static_cast<GameState>(frame.State);
+    if (state == GAME_ACTIVE || state == GAME_MENU || state == GAME_WIN)
+    {
+        unsigned int scene = PostEffects->SceneTarget(*Graph);
+        Graph->AddPass("scene", {}, scene, [&frame]() {
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            unsigned int count = static_cast<unsigned int>(frame.Sprites.size());
+            Renderer->Submit(frame.Sprites.data(), 0, frame.ParticleLayer);
+            Particles->Draw();
+            Renderer->Submit(frame.Sprites.data(), frame.ParticleLayer, count);
+        });
+        PostEffects->AddPasses(*Graph, scene);
+
+        LivesText.SetValue("Lives:", frame.Lives);
+        LevelText.SetValue("Level:", frame.Level + 1, "/4");
+        Text->Draw(LivesText);
+        Text->Draw(LevelText);
+        Text->Draw(MoveText);
+        Text->Draw(PauseText);
     }
     
     // ˵ؿѡ˵
-    if (this->State == GAME_MENU)
+    if (state == GAME_MENU)
     {
-        Text->RenderText("Press ENTER to start", 250.0f, Height / 2, 1.0f);
+        Text->Draw(MenuText);
     }
 
     // ʤ
-    if (this->State == GAME_WIN)
+    if (state == GAME_WIN)
+    {
+        Text->Draw(WinText);
+        Text->Draw(QuitText);
+    }
+
+    // Ϣ: ÿpassGPUʱ(֡ǰĲѯ), Լһ֡İȾͼͳ
+    if (frame.Overlay)
+    {
+        char line[96];
+        float x = this->Width - 330.0f, y = 5.0f;
+        glm::vec3 color(1.0f, 1.0f, 0.5f);
+        Text->RenderText("GPU ms             min    avg    p99", x, y, 0.5f, color);
+        for (const PassTiming& timing : Graph->Timings())
+        {
+            y += 12.0f;
+            std::snprintf(line, sizeof(line), "%-16s %6.2f %6.2f %6.2f", timing.Name, timing.Min, timing.Average, timing.P99);
+            Text->RenderText(line, x, y, 0.5f, color);
+        }
+        std::snprintf(line, sizeof(line), "binds %u issued %u skipped", GLState::LastIssued, GLState::LastSkipped);
+        Text->RenderText(line, x, y + 18.0f, 0.5f, color);
+        std::snprintf(line, sizeof(line), "passes %u run %u culled, %u targets", Graph->PassesRun, Graph->PassesCulled, Graph->TargetsAllocated);
+        Text->RenderText(line, x, y + 30.0f, 0.5f, color);
+        if (Governor.Budget() > 0.0f)
+        {
+            std::snprintf(line, sizeof(line), "quality level %u, %.1f ms budget", Governor.Level(), Governor.Budget());
+            Text->RenderText(line, x, y + 42.0f, 0.5f, color);
+        }
+    }
+
+    // ֡ı, һλ
+    Graph->AddPass("text", {}, RenderGraph::BACKBUFFER, []() { Text->Flush(); });
+    Graph->Execute();
+    RenderTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Game::SetFrameBudget(float milliseconds)
+{
+    Governor.SetBudget(milliseconds);
+    Particles->SetBudget(static_cast<unsigned int>(Particles->Capacity() * Governor.Limits().ParticleShare));
+}
+
+void Game::Resize(unsigned int framebufferWidth, unsigned int framebufferHeight)
+{
+    // Сʱ֡Ϊ0, ԭгߴ
+    if (framebufferWidth == 0 || framebufferHeight == 0)
+        return;
+    FramebufferWidth = framebufferWidth;
+    FramebufferHeight = framebufferHeight;
+    // Ϸ߼ʼʹWidth x Height, ŵ֡вֿ߱(»ڱ)
+    float scale = std::min(static_cast<float>(framebufferWidth) / this->Width, static_cast<float>(framebufferHeight) / this->Height);
+    unsigned int outputWidth = std::max(static_cast<unsigned int>(this->Width * scale), 1u);
+    unsigned int outputHeight = std::max(static_cast<unsigned int>(this->Height * scale), 1u);
+    Graph->SetOutput((framebufferWidth - outputWidth) / 2, (framebufferHeight - outputHeight) / 2, outputWidth, outputHeight);
+    Graph->SetSize(std::max(static_cast<unsigned int>(outputWidth * AppliedRenderScale), 1u),
+                   std::max(static_cast<unsigned int>(outputHeight * AppliedRenderScale), 1u));
+}
+
+void Game::SetOutputFramebuffer(unsigned int fbo)
+{
+    Graph->SetBackbuffer(fbo);
+}
+
+std::vector<PassTiming> Game::PassTimings() const
+{
+    return Graph->Timings();
+}
+
+bool Game::FrameIsStatic() const
+{
+    return LastFrameStatic;
+}
+
+void Game::CacheFrame()
+{
+    if (CacheFBO == 0)
     {
-        Text->RenderText(
-            "You WON!!!", 320.0, Height / 2 - 20.0, 1.0, glm::vec3(0.0, 1.0, 0.0)
-        );
-        Text->RenderText(
-            "Press ESC to quit", 280, Height / 2, 1.0, glm::vec3(1.0, 1.0, 0.0)
-        );
+        glGenFramebuffers(1, &CacheFBO);
+        glGenTextures(1, &CacheTexture);
     }
+    if (CacheWidth != FramebufferWidth || CacheHeight != FramebufferHeight)
+    {
+        CacheWidth = FramebufferWidth;
+        CacheHeight = FramebufferHeight;
+        GLState::BindTextureForEdit(0, CacheTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, CacheWidth, CacheHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, CacheFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, CacheTexture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::GAME: Failed to initialize frame cache FBO" << std::endl;
+    }
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, CacheFBO);
+    glBlitFramebuffer(0, 0, CacheWidth, CacheHeight, 0, 0, CacheWidth, CacheHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Game::PresentCachedFrame()
+{
+    if (CacheFBO == 0)
+        return;
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, CacheFBO);
+    GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, CacheWidth, CacheHeight, 0, 0, CacheWidth, CacheHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Game::ResetLevel()
@@ -322,35 +647,36 @@ void Game::DoCollisions()
                     if (box.Color == glm::vec3(0.2f, 0.6f, 1.0f)) 
                     {
                         box.Destroyed = true;
+                        Commands->Emit("brick_shatter", box.Position + box.Size / 2.0f, Ball->Velocity, box.Color);
                         this->SpawnPowerUps(box);
                         // ײשЧ
-                        SoundEngine->play2D("resources/audio/bleep.mp3", false);
+                        PlayAudio("resources/audio/bleep.mp3", false);
                     }
                     else if (box.Color == glm::vec3(0.0f, 0.7f, 0.0f)) 
                     {
                         box.Color = glm::vec3(0.2f, 0.6f, 1.0f);
                         this->SpawnPowerUps(box);
-                        SoundEngine->play2D("resources/audio/bleep.mp3", false);
+                        PlayAudio("resources/audio/bleep.mp3", false);
                     }
                     else if (box.Color == glm::vec3(0.8f, 0.8f, 0.4f)) 
                     {
                         box.Color = glm::vec3(0.0f, 0.7f, 0.0f);
                         this->SpawnPowerUps(box);
-                        SoundEngine->play2D("resources/audio/bleep.mp3", false);
+                        PlayAudio("resources/audio/bleep.mp3", false);
                     }
                     else if(box.Color == glm::vec3(1.0f, 0.5f, 0.0f))
                     {
                         box.Color = glm::vec3(0.8f, 0.8f, 0.4f);
                         this->SpawnPowerUps(box);
-                        SoundEngine->play2D("resources/audio/bleep.mp3", false);
+                        PlayAudio("resources/audio/bleep.mp3", false);
                     }
                 }
                 else
                 {
                     ShakeTime = 0.05f;
-                    Effects->Shake = true;
+                    Effects.Shake = true;
                     // ײЧ
-                    SoundEngine->play2D("resources/audio/solid.wav", false);
+                    PlayAudio("resources/audio/solid.wav", false);
                 }
                 Direction dir = std::get<1>(collision);
                 glm::vec2 diff_vector = std::get<2>(collision);
@@ -393,8 +719,9 @@ void Game::DoCollisions()
         Ball->Velocity = glm::normalize(Ball->Velocity) * glm::length(oldVelocity);
         Ball->Velocity.y = -1.0f * abs(Ball->Velocity.y);
         Ball->Stuck = Ball->Sticky;
+        Commands->Emit("paddle_impact", Ball->Position + glm::vec2(Ball->Radius, Ball->Radius * 2.0f), Ball->Velocity);
         // ײЧ
-        SoundEngine->play2D("resources/audio/bleep.wav", false);
+        PlayAudio("resources/audio/bleep.wav", false);
     }
 
     // ײ
@@ -407,10 +734,11 @@ void Game::DoCollisions()
             if (CheckCollision(*Player, powerUp))
             {
                 ActivatePowerUp(powerUp);
+                Commands->Emit("powerup_pickup", powerUp.Position + powerUp.Size / 2.0f, glm::vec2(0.0f), powerUp.Color);
                 powerUp.Destroyed = GL_TRUE;
                 powerUp.Activated = GL_TRUE;
                 // ײЧ
-                SoundEngine->play2D("resources/audio/powerup.wav", false);
+                PlayAudio("resources/audio/powerup.wav", false);
             }
         }
     }
@@ -474,17 +802,17 @@ bool ShouldSpawn(unsigned int chance)
 void Game::SpawnPowerUps(GameObject& block)
 {
     if (ShouldSpawn(25))
-        this->PowerUps.push_back(PowerUp("speed", glm::vec3(0.5f, 0.5f, 1.0f), 0.0f, block.Position, ResourceManager::GetTexture("tex_speed")));
+        this->PowerUps.push_back(PowerUp("speed", glm::vec3(0.5f, 0.5f, 1.0f), 0.0f, block.Position, ResourceManager::GetTexture(SPEED_TEXTURE)));
     if (ShouldSpawn(25))
-        this->PowerUps.push_back(PowerUp("sticky", glm::vec3(0.5f, 0.5f, 1.0f), 10.0f, block.Position, ResourceManager::GetTexture("tex_sticky")));
+        this->PowerUps.push_back(PowerUp("sticky", glm::vec3(0.5f, 0.5f, 1.0f), 10.0f, block.Position, ResourceManager::GetTexture(STICKY_TEXTURE)));
     if (ShouldSpawn(25))
-        this->PowerUps.push_back(PowerUp("pass-through", glm::vec3(0.5f, 1.0f, 0.5f), 10.0f, block.Position, ResourceManager::GetTexture("tex_passthrough")));
+        this->PowerUps.push_back(PowerUp("pass-through", glm::vec3(0.5f, 1.0f, 0.5f), 10.0f, block.Position, ResourceManager::GetTexture(PASSTHROUGH_TEXTURE)));
     if (ShouldSpawn(50))
-        this->PowerUps.push_back(PowerUp("pad-size-increase", glm::vec3(1.0f, 0.6f, 0.4), 3.0f, block.Position, ResourceManager::GetTexture("tex_increase")));
+        this->PowerUps.push_back(PowerUp("pad-size-increase", glm::vec3(1.0f, 0.6f, 0.4), 3.0f, block.Position, ResourceManager::GetTexture(INCREASE_TEXTURE)));
     if (ShouldSpawn(25)) // ߱Ƶ
-        this->PowerUps.push_back(PowerUp("confuse", glm::vec3(1.0f, 0.3f, 0.3f), 3.0f, block.Position, ResourceManager::GetTexture("tex_confuse")));
+        this->PowerUps.push_back(PowerUp("confuse", glm::vec3(1.0f, 0.3f, 0.3f), 3.0f, block.Position, ResourceManager::GetTexture(CONFUSE_TEXTURE)));
     if (ShouldSpawn(25))
-        this->PowerUps.push_back(PowerUp("chaos", glm::vec3(0.9f, 0.25f, 0.25f), 3.0f, block.Position, ResourceManager::GetTexture("tex_chaos")));
+        this->PowerUps.push_back(PowerUp("chaos", glm::vec3(0.9f, 0.25f, 0.25f), 3.0f, block.Position, ResourceManager::GetTexture(CHAOS_TEXTURE)));
 }
 
 void ActivatePowerUp(PowerUp& powerUp)
@@ -510,13 +838,11 @@ void ActivatePowerUp(PowerUp& powerUp)
     }
     else if (powerUp.Type == "confuse")
     {
-        if (!Effects->Chaos)
-            Effects->Confuse = GL_TRUE; // ֻchaosδʱЧchaosͬ
+        Effects.Confuse = GL_TRUE; // ЧԵ, öӦɫһ
     }
     else if (powerUp.Type == "chaos")
     {
-        if (!Effects->Confuse)
-            Effects->Chaos = GL_TRUE;
+        Effects.Chaos = GL_TRUE;
     }
 }
 
@@ -571,14 +897,14 @@ void Game::UpdatePowerUps(GLfloat dt) {
                 {
                     if (!IsOtherPowerUpActive(this->PowerUps, "confuse"))
                     {
-                        Effects->Confuse = GL_FALSE;
+                        Effects.Confuse = GL_FALSE;
                     }
                 }
                 else if (powerUp.Type == "chaos")   //
                 {
                     if (!IsOtherPowerUpActive(this->PowerUps, "chaos"))
                     {
-                        Effects->Chaos = GL_FALSE;
+                        Effects.Chaos = GL_FALSE;
                     }
                 }
             }
@@ -5,6 +5,7 @@
 #include <GLFW/glfw3.h>
 #include "game_level.h"
 #include "power_up.h"
+#include "render_graph.h"
 #include <vector>
 
 enum GameState
@@ -48,10 +49,28 @@ public:
 	~Game();
 
 	void Init();
+	// GL߳: ResourceManager::Clear֮ǰ, ͷϷеGLԴ, ظ
+	void Shutdown();
 
 	void ProcessInput(float dt);
 	void Update(float dt);
-	void Render();
+	// ģ߳: 벢һ֡, ѻ¼Ƶframe
+	void Simulate(float dt, RenderCommandList& frame);
+	// GL߳: ύһ֡¼Ƶ
+	void Render(const RenderCommandList& frame);
+	// GL߳: ֡С仯(, ȫ, DPI)ʱ, λΪ
+	void Resize(unsigned int framebufferWidth, unsigned int framebufferHeight);
+	// GL߳: 洰ں󻺳֡, Ⱦʱʹ, 0Ϊڱ
+	void SetOutputFramebuffer(unsigned int fbo);
+	// GL߳, Init֮: ÿ֡ʱԤ(), ֡ʱ䳬ʱ𼶽ͻ, ÿεӡ; 0ر(Ĭ)
+	void SetFrameBudget(float milliseconds);
+	// GL߳: ȾpassGPUʱͳ(F3ʾ)
+	std::vector<PassTiming> PassTimings() const;
+	// GL߳: һύ֡Ƿֹ(˵, ʤ, ͣ), ֹʱѭֻȴ
+	bool FrameIsStatic() const;
+	// GL߳: ǰѺ󻺳帴Ƶ, ֮󴰿ҪػʱֱʾȾ
+	void CacheFrame();
+	void PresentCachedFrame();
 	void DoCollisions();
 
 	void ResetLevel();
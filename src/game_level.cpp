@@ -1,15 +1,18 @@
 #include "game_level.h"
+#include "asset_pack.h"
 
-#include <fstream>
 #include <sstream>
 
+constexpr ResourceId BLOCK_SOLID_TEXTURE("block_solid");
+constexpr ResourceId BLOCK_TEXTURE("block");
+
 void GameLevel::Load(const char* file, unsigned int levelWidth, unsigned int levelHeight)
 {
     this->Bricks.clear();
     unsigned int tileCode;
     GameLevel level;
     std::string line;
-    std::ifstream fstream(file);
+    std::istringstream fstream(AssetPack::Read(file).Text());
     std::vector<std::vector<unsigned int>> tileData;
     if (fstream)
     {
@@ -26,11 +29,11 @@ void GameLevel::Load(const char* file, unsigned int levelWidth, unsigned int lev
     }
 }
 
-void GameLevel::Draw(SpriteRenderer& renderer)
+void GameLevel::Draw(RenderCommandList& commands)
 {
     for (GameObject& tile : this->Bricks)
         if (!tile.Destroyed)
-            tile.Draw(renderer);
+            tile.Draw(commands);
 }
 
 bool GameLevel::IsCompleted()
@@ -54,7 +57,7 @@ void GameLevel::init(std::vector<std::vector<unsigned int>> tileData, unsigned i
             {
                 glm::vec2 pos(unit_width * x, unit_height * y);
                 glm::vec2 size(unit_width, unit_height);
-                GameObject obj(pos, size, ResourceManager::GetTexture("block_solid"), glm::vec3(0.8f, 0.8f, 0.7f));
+                GameObject obj(pos, size, ResourceManager::GetTexture(BLOCK_SOLID_TEXTURE), glm::vec3(0.8f, 0.8f, 0.7f));
                 obj.IsSolid = true;
                 this->Bricks.push_back(obj);
             }
@@ -72,7 +75,7 @@ void GameLevel::init(std::vector<std::vector<unsigned int>> tileData, unsigned i
 
                 glm::vec2 pos(unit_width * x, unit_height * y);
                 glm::vec2 size(unit_width, unit_height);
-                this->Bricks.push_back(GameObject(pos, size, ResourceManager::GetTexture("block"), color));
+                this->Bricks.push_back(GameObject(pos, size, ResourceManager::GetTexture(BLOCK_TEXTURE), color));
             }
         }
     }
@@ -19,7 +19,7 @@ public:
 
 	void Load(const char* file, unsigned int levelWidth, unsigned int levelHeight);
 
-	void Draw(SpriteRenderer& renderer);
+	void Draw(RenderCommandList& commands);
 
 	bool IsCompleted();
 
@@ -6,6 +6,8 @@
 
 #include "texture.h"
 #include "sprite_renderer.h"
+#include "render_commands.h"
+#include "resource_manager.h"
 
 class GameObject
 {
@@ -16,12 +18,12 @@ public:
 	bool        IsSolid;
 	bool        Destroyed;
 
-	Texture2D   Sprite;
+	TextureHandle Sprite;
 
 	GameObject();
-	GameObject(glm::vec2 pos, glm::vec2 size, Texture2D sprite, glm::vec3 color = glm::vec3(1.0f), glm::vec2 velocity = glm::vec2(0.0f, 0.0f));
+	GameObject(glm::vec2 pos, glm::vec2 size, TextureHandle sprite, glm::vec3 color = glm::vec3(1.0f), glm::vec2 velocity = glm::vec2(0.0f, 0.0f));
 
-	virtual void Draw(SpriteRenderer& renderer);
+	virtual void Draw(RenderCommandList& commands);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "gl_state.h"
+
+// never a valid object name, so the first bind after Invalidate is always issued
+static const unsigned int UNKNOWN = ~0u;
+
+unsigned int GLState::Issued = 0;
+unsigned int GLState::Skipped = 0;
+unsigned int GLState::LastIssued = 0;
+unsigned int GLState::LastSkipped = 0;
+unsigned int GLState::program = UNKNOWN;
+unsigned int GLState::activeUnit = UNKNOWN;
+unsigned int GLState::textures[GLState::MAX_TEXTURE_UNITS] = {
+    UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN,
+    UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN
+};
+unsigned int GLState::vao = UNKNOWN;
+unsigned int GLState::readFramebuffer = UNKNOWN;
+unsigned int GLState::drawFramebuffer = UNKNOWN;
+
+void GLState::UseProgram(unsigned int program)
+{
+    if (GLState::program == program)
+    {
+        Skipped++;
+        return;
+    }
+    glUseProgram(program);
+    GLState::program = program;
+    Issued++;
+}
+
+void GLState::ActiveTexture(unsigned int unit)
+{
+    if (activeUnit == unit)
+    {
+        Skipped++;
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+    Issued++;
+}
+
+void GLState::BindTexture(unsigned int unit, unsigned int texture)
+{
+    if (unit < MAX_TEXTURE_UNITS && textures[unit] == texture)
+    {
+        Skipped++;
+        return;
+    }
+    ActiveTexture(unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (unit < MAX_TEXTURE_UNITS)
+        textures[unit] = texture;
+    Issued++;
+}
+
+void GLState::BindTextureForEdit(unsigned int unit, unsigned int texture)
+{
+    ActiveTexture(unit);
+    BindTexture(unit, texture);
+}
+
+void GLState::BindVertexArray(unsigned int vao)
+{
+    if (GLState::vao == vao)
+    {
+        Skipped++;
+        return;
+    }
+    glBindVertexArray(vao);
+    GLState::vao = vao;
+    Issued++;
+}
+
+void GLState::BindFramebuffer(GLenum target, unsigned int fbo)
+{
+    bool read = target != GL_DRAW_FRAMEBUFFER;
+    bool draw = target != GL_READ_FRAMEBUFFER;
+    if ((!read || readFramebuffer == fbo) && (!draw || drawFramebuffer == fbo))
+    {
+        Skipped++;
+        return;
+    }
+    glBindFramebuffer(target, fbo);
+    if (read)
+        readFramebuffer = fbo;
+    if (draw)
+        drawFramebuffer = fbo;
+    Issued++;
+}
+
+void GLState::Invalidate()
+{
+    program = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; ++i)
+        textures[i] = UNKNOWN;
+    vao = UNKNOWN;
+    readFramebuffer = UNKNOWN;
+    drawFramebuffer = UNKNOWN;
+}
+
+void GLState::BeginFrame()
+{
+    LastIssued = Issued;
+    LastSkipped = Skipped;
+    Issued = 0;
+    Skipped = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// Mirrors the bindings the renderers change every frame and drops the calls that
+// would not change anything. Every bind of these kinds must go through here,
+// otherwise the mirror goes stale; call Invalidate after deleting bound objects.
+class GLState
+{
+public:
+	static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+	// binds issued to / skipped before the driver, this frame and the last one
+	static unsigned int Issued, Skipped;
+	static unsigned int LastIssued, LastSkipped;
+
+	static void UseProgram(unsigned int program);
+	// unit is an index, not GL_TEXTURE0 + index
+	static void ActiveTexture(unsigned int unit);
+	// for sampling: a skipped bind leaves the active unit as it was
+	static void BindTexture(unsigned int unit, unsigned int texture);
+	// before glTexImage2D, glTexParameteri and the like, which edit the texture bound on
+	// the active unit: also selects unit when the bind itself is skipped
+	static void BindTextureForEdit(unsigned int unit, unsigned int texture);
+	static void BindVertexArray(unsigned int vao);
+	// GL_FRAMEBUFFER sets both the read and the draw binding
+	static void BindFramebuffer(GLenum target, unsigned int fbo);
+
+	// forget everything, the next bind of each kind always reaches the driver
+	static void Invalidate();
+	static void BeginFrame();
+private:
+	GLState() {}
+	static unsigned int program;
+	static unsigned int activeUnit;
+	static unsigned int textures[MAX_TEXTURE_UNITS];
+	static unsigned int vao;
+	static unsigned int readFramebuffer, drawFramebuffer;
+};
+
+#endif
@@ -0,0 +1,364 @@
+#include "headless.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#ifdef BREAKOUT_EGL
+// keep eglplatform.h from pulling in X11, the context has no window system
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "gl_state.h"
+#include "png_writer.h"
+#include "render_commands.h"
+#include "resource_manager.h"
+
+// frames of GPU timestamps in flight, results are read back this many frames late so the CPU never waits
+const unsigned int TIMER_QUERIES = 4;
+
+struct ScriptEvent {
+    unsigned int Frame;
+    int          Key;
+    bool         Press;
+};
+
+struct HeadlessContext {
+#ifdef BREAKOUT_EGL
+    EGLDisplay Display;
+    EGLContext Context;
+#else
+    GLFWwindow* Window;
+#endif
+};
+
+static bool createContext(HeadlessContext& context)
+{
+#ifdef BREAKOUT_EGL
+    // surfaceless Mesa (llvmpipe without a display) first, then whatever the default display is
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    context.Display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+    if (context.Display == EGL_NO_DISPLAY)
+        context.Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (context.Display == EGL_NO_DISPLAY || !eglInitialize(context.Display, &major, &minor))
+    {
+        std::cout << "ERROR::HEADLESS: Failed to initialize EGL" << std::endl;
+        return false;
+    }
+    // the surface type defaults to window, which surfaceless displays have none of
+    const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config;
+    EGLint configs = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(context.Display, configAttributes, &config, 1, &configs) || configs == 0)
+    {
+        std::cout << "ERROR::HEADLESS: No EGL config supports desktop OpenGL" << std::endl;
+        return false;
+    }
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+    context.Context = eglCreateContext(context.Display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context.Context == EGL_NO_CONTEXT || !eglMakeCurrent(context.Display, EGL_NO_SURFACE, EGL_NO_SURFACE, context.Context))
+    {
+        std::cout << "ERROR::HEADLESS: Failed to create a surfaceless OpenGL 3.3 core context" << std::endl;
+        return false;
+    }
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        return false;
+    Shader::LoadExtensions((GLADloadproc)eglGetProcAddress);
+    return true;
+#else
+    // a window that is never shown, everything is drawn into the offscreen framebuffer
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, false);
+    context.Window = glfwCreateWindow(64, 64, "Breakout", nullptr, nullptr);
+    if (!context.Window)
+    {
+        std::cout << "ERROR::HEADLESS: Failed to create a hidden window" << std::endl;
+        return false;
+    }
+    glfwMakeContextCurrent(context.Window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        return false;
+    Shader::LoadExtensions((GLADloadproc)glfwGetProcAddress);
+    return true;
+#endif
+}
+
+static void destroyContext(HeadlessContext& context)
+{
+#ifdef BREAKOUT_EGL
+    eglMakeCurrent(context.Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(context.Display, context.Context);
+    eglTerminate(context.Display);
+#else
+    glfwDestroyWindow(context.Window);
+    glfwTerminate();
+#endif
+}
+
+static int keyCode(const std::string& name)
+{
+    if (name.size() == 1 && ((name[0] >= 'A' && name[0] <= 'Z') || (name[0] >= '0' && name[0] <= '9')))
+        return name[0];
+    if (name.size() == 1 && name[0] >= 'a' && name[0] <= 'z')
+        return name[0] - 'a' + 'A';
+    if (name == "[")      return GLFW_KEY_LEFT_BRACKET;
+    if (name == "]")      return GLFW_KEY_RIGHT_BRACKET;
+    if (name == "SPACE")  return GLFW_KEY_SPACE;
+    if (name == "ESCAPE") return GLFW_KEY_ESCAPE;
+    if (name == "ENTER")  return GLFW_KEY_ENTER;
+    if (name == "RIGHT")  return GLFW_KEY_RIGHT;
+    if (name == "LEFT")   return GLFW_KEY_LEFT;
+    if (name == "DOWN")   return GLFW_KEY_DOWN;
+    if (name == "UP")     return GLFW_KEY_UP;
+    if (name.size() >= 2 && name[0] == 'F' && std::atoi(name.c_str() + 1) >= 1 && std::atoi(name.c_str() + 1) <= 12)
+        return GLFW_KEY_F1 + std::atoi(name.c_str() + 1) - 1;
+    return -1;
+}
+
+static bool loadScript(const std::string& path, std::vector<ScriptEvent>& events)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::HEADLESS: Failed to read script " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+        ScriptEvent event;
+        std::string key, action;
+        if (!(stream >> event.Frame))
+            continue;
+        event.Key = stream >> key >> action ? keyCode(key) : -1;
+        if (event.Key < 0 || (action != "press" && action != "release"))
+        {
+            std::cout << "ERROR::HEADLESS: " << path << ":" << lineNumber << ": expected <frame> <key> <press|release>" << std::endl;
+            return false;
+        }
+        event.Press = action == "press";
+        events.push_back(event);
+    }
+    std::stable_sort(events.begin(), events.end(), [](const ScriptEvent& a, const ScriptEvent& b) { return a.Frame < b.Frame; });
+    return true;
+}
+
+// mean, median, 95th percentile and worst of the valid (non negative) times
+static void summarize(const char* label, const std::vector<double>& times)
+{
+    std::vector<double> valid;
+    double total = 0.0;
+    for (double time : times)
+        if (time >= 0.0)
+        {
+            valid.push_back(time);
+            total += time;
+        }
+    if (valid.empty())
+        return;
+    std::sort(valid.begin(), valid.end());
+    std::cout << label << " ms over " << valid.size() << " frames: mean " << total / valid.size()
+              << ", p50 " << valid[valid.size() / 2]
+              << ", p95 " << valid[std::min(valid.size() * 95 / 100, valid.size() - 1)]
+              << ", max " << valid.back() << std::endl;
+}
+
+bool ParseHeadlessOptions(int argc, char* argv[], HeadlessOptions& options)
+{
+    options.Frames = 0;
+    options.Width = 800;
+    options.Height = 600;
+    options.Step = 1.0f / 60.0f;
+    options.Capture.clear();
+    options.Script.clear();
+    options.Output = ".";
+    options.Budget = 0.0f;
+    bool headless = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : "";
+        if (argument == "--headless")
+        {
+            headless = true;
+            options.Frames = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            ++i;
+        }
+        else if (argument == "--size")
+        {
+            std::sscanf(value, "%ux%u", &options.Width, &options.Height);
+            ++i;
+        }
+        else if (argument == "--step")
+        {
+            options.Step = static_cast<float>(std::atof(value));
+            ++i;
+        }
+        else if (argument == "--capture")
+        {
+            std::istringstream list(value);
+            std::string frame;
+            while (std::getline(list, frame, ','))
+                options.Capture.push_back(static_cast<unsigned int>(std::strtoul(frame.c_str(), nullptr, 10)));
+            ++i;
+        }
+        else if (argument == "--script")
+        {
+            options.Script = value;
+            ++i;
+        }
+        else if (argument == "--output")
+        {
+            options.Output = value;
+            ++i;
+        }
+        else if (argument == "--budget")
+        {
+            options.Budget = static_cast<float>(std::atof(value));
+            ++i;
+        }
+    }
+    if (headless && options.Frames == 0)
+        options.Frames = 1;
+    options.Width = std::max(options.Width, 1u);
+    options.Height = std::max(options.Height, 1u);
+    return headless;
+}
+
+int RunHeadless(Game& game, const HeadlessOptions& options)
+{
+    std::vector<ScriptEvent> events;
+    if (!options.Script.empty() && !loadScript(options.Script, events))
+        return -1;
+
+    HeadlessContext context;
+    if (!createContext(context))
+        return -1;
+    std::cout << "Headless: " << glGetString(GL_RENDERER) << ", " << options.Width << "x" << options.Height
+              << ", " << options.Frames << " frames" << std::endl;
+
+    // the window's back buffer is replaced by this framebuffer
+    unsigned int fbo, color;
+    glGenFramebuffers(1, &fbo);
+    glGenTextures(1, &color);
+    GLState::BindTextureForEdit(0, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, options.Width, options.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::HEADLESS: Framebuffer is not complete!" << std::endl;
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // particles and power ups use rand, the same seed gives the same images
+    std::srand(1);
+    game.Init();
+    // captured frames must not depend on how fast the textures decoded
+    ResourceManager::FinishTextures();
+    game.SetOutputFramebuffer(fbo);
+    game.Resize(options.Width, options.Height);
+    game.SetFrameBudget(options.Budget);
+
+    // timestamps around the frame rather than an elapsed query, the render graph times each pass with those
+    unsigned int queries[TIMER_QUERIES * 2];
+    glGenQueries(TIMER_QUERIES * 2, queries);
+    std::vector<double> cpuTimes(options.Frames, 0.0), gpuTimes(options.Frames, -1.0);
+    std::vector<std::chrono::steady_clock::time_point> queryStart(options.Frames);
+    std::vector<unsigned char> pixels(static_cast<size_t>(options.Width) * options.Height * 4);
+    // a GPU time longer than the wall time since the frame began is a driver error, it is reported as -1
+    auto readQuery = [&](unsigned int i) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(queries[i % TIMER_QUERIES * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries[i % TIMER_QUERIES * 2 + 1], GL_QUERY_RESULT, &end);
+        double elapsed = static_cast<double>(end - begin);
+        double bound = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queryStart[i]).count();
+        gpuTimes[i] = elapsed / 1000000.0 <= bound ? elapsed / 1000000.0 : -1.0;
+    };
+
+    // simulate and render on this thread, one after the other: with the worker thread
+    // the order of rand calls between simulation and particles would vary run to run
+    RenderCommandList frame;
+    size_t nextEvent = 0;
+    for (unsigned int i = 0; i < options.Frames; ++i)
+    {
+        for (; nextEvent < events.size() && events[nextEvent].Frame <= i; ++nextEvent)
+        {
+            const ScriptEvent& event = events[nextEvent];
+            game.Keys[event.Key] = event.Press;
+            if (!event.Press)
+                game.KeysProcessed[event.Key] = false;
+        }
+        if (i >= TIMER_QUERIES)
+            readQuery(i - TIMER_QUERIES);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        frame.Clear();
+        game.Simulate(options.Step, frame);
+        queryStart[i] = std::chrono::steady_clock::now();
+        glQueryCounter(queries[i % TIMER_QUERIES * 2], GL_TIMESTAMP);
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, options.Width, options.Height);
+        glClearColor(0.0f, 0.15f, 0.25f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        game.Render(frame);
+        glQueryCounter(queries[i % TIMER_QUERIES * 2 + 1], GL_TIMESTAMP);
+        cpuTimes[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (std::find(options.Capture.begin(), options.Capture.end(), i) != options.Capture.end())
+        {
+            GLState::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, options.Width, options.Height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            char name[32];
+            std::snprintf(name, sizeof(name), "/frame_%04u.png", i);
+            WritePNG((options.Output + name).c_str(), options.Width, options.Height, pixels.data());
+        }
+    }
+    for (unsigned int i = options.Frames > TIMER_QUERIES ? options.Frames - TIMER_QUERIES : 0; i < options.Frames; ++i)
+        readQuery(i);
+
+    std::ofstream timings(options.Output + "/timings.csv");
+    timings << "frame,cpu_ms,gpu_ms\n";
+    for (unsigned int i = 0; i < options.Frames; ++i)
+        timings << i << "," << cpuTimes[i] << "," << gpuTimes[i] << "\n";
+    summarize("CPU", cpuTimes);
+    summarize("GPU", gpuTimes);
+    for (const PassTiming& timing : game.PassTimings())
+        std::cout << "  " << timing.Name << ": min " << timing.Min << ", avg " << timing.Average
+                  << ", p99 " << timing.P99 << " ms over the last " << timing.Samples << " frames" << std::endl;
+
+    glDeleteQueries(TIMER_QUERIES * 2, queries);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &color);
+    GLState::Invalidate();
+    game.Shutdown();
+    ResourceManager::Clear();
+    destroyContext(context);
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <string>
+#include <vector>
+
+#include "game.h"
+
+// An offscreen run: a scripted session rendered into a framebuffer for a fixed
+// number of frames, for golden image and render timing tests without a display.
+//
+//   BreakOut --headless 600 --size 1280x720 --script session.txt --capture 1,120,599 --output out
+//
+// --budget 16.7 lets the quality governor step down like a windowed run does.
+// The script holds one "<frame> <key> <press|release>" per line, # starts a comment.
+// Keys are letters, digits, F1 to F12 or SPACE, ENTER, ESCAPE, LEFT, RIGHT, UP, DOWN, [, ].
+struct HeadlessOptions {
+    unsigned int Frames;
+    unsigned int Width, Height;
+    // fixed simulation step, so a run is the same on every machine
+    float        Step;
+    std::vector<unsigned int> Capture;
+    std::string  Script;
+    // directory the PNGs and timings.csv are written to, must exist
+    std::string  Output;
+    // frame budget in ms for the quality governor (--budget), 0 keeps the quality fixed
+    // so the images are the same on every machine
+    float        Budget;
+};
+
+// false when the command line does not ask for a headless run
+bool ParseHeadlessOptions(int argc, char* argv[], HeadlessOptions& options);
+// creates the context (EGL surfaceless with BREAKOUT_EGL, otherwise a hidden GLFW
+// window), initializes the game and runs the session; returns the exit code
+int RunHeadless(Game& game, const HeadlessOptions& options);
+
+#endif
@@ -0,0 +1,127 @@
+#include "lz4_block.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+const size_t MIN_MATCH = 4;
+// the format ends every block with literals: a match stops 5 bytes before the end
+// and none starts in the last 12
+const size_t LAST_LITERALS = 5;
+const size_t MATCH_LIMIT = 12;
+const size_t MAX_OFFSET = 65535;
+const unsigned int HASH_BITS = 16;
+
+static uint32_t read32(const unsigned char* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void writeLength(std::vector<unsigned char>& out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        out.push_back(255);
+    out.push_back(static_cast<unsigned char>(length));
+}
+
+// a token with its literals, then the match unless it is the last sequence (length 0)
+static void writeSequence(std::vector<unsigned char>& out, const unsigned char* literals, size_t count, size_t offset, size_t length)
+{
+    size_t matchCode = length ? length - MIN_MATCH : 0;
+    out.push_back(static_cast<unsigned char>((std::min<size_t>(count, 15) << 4) | std::min<size_t>(matchCode, 15)));
+    if (count >= 15)
+        writeLength(out, count - 15);
+    out.insert(out.end(), literals, literals + count);
+    if (!length)
+        return;
+    out.push_back(static_cast<unsigned char>(offset & 0xFF));
+    out.push_back(static_cast<unsigned char>(offset >> 8));
+    if (matchCode >= 15)
+        writeLength(out, matchCode - 15);
+}
+
+std::vector<unsigned char> LZ4Compress(const unsigned char* source, size_t size)
+{
+    std::vector<unsigned char> out;
+    out.reserve(size + size / 255 + 16);
+    // last position each 4 byte sequence was seen at, plus one so 0 means never
+    std::vector<size_t> table(size_t(1) << HASH_BITS, 0);
+    size_t anchor = 0, i = 0;
+    while (i + MATCH_LIMIT < size)
+    {
+        uint32_t sequence = read32(source + i);
+        size_t slot = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        size_t candidate = table[slot];
+        table[slot] = i + 1;
+        if (candidate == 0 || i - (candidate - 1) > MAX_OFFSET || read32(source + candidate - 1) != sequence)
+        {
+            ++i;
+            continue;
+        }
+        candidate--;
+        size_t length = MIN_MATCH, limit = size - LAST_LITERALS - i;
+        while (length < limit && source[candidate + length] == source[i + length])
+            ++length;
+        writeSequence(out, source + anchor, i - anchor, i - candidate, length);
+        i += length;
+        anchor = i;
+    }
+    writeSequence(out, source + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+static bool readLength(const unsigned char*& in, const unsigned char* end, size_t& length)
+{
+    unsigned char byte;
+    do
+    {
+        if (in >= end)
+            return false;
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool LZ4Decompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t size)
+{
+    const unsigned char* in = source;
+    const unsigned char* inEnd = source + sourceSize;
+    unsigned char* out = destination;
+    unsigned char* outEnd = destination + size;
+    while (in < inEnd)
+    {
+        unsigned int token = *in++;
+        size_t count = token >> 4;
+        if (count == 15 && !readLength(in, inEnd, count))
+            return false;
+        if (count > static_cast<size_t>(inEnd - in) || count > static_cast<size_t>(outEnd - out))
+            return false;
+        std::memcpy(out, in, count);
+        in += count;
+        out += count;
+        if (in == inEnd)
+            break;
+
+        if (inEnd - in < 2)
+            return false;
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > static_cast<size_t>(out - destination))
+            return false;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(in, inEnd, length))
+            return false;
+        length += MIN_MATCH;
+        if (length > static_cast<size_t>(outEnd - out))
+            return false;
+        // byte by byte: the match may overlap what it is writing
+        const unsigned char* match = out - offset;
+        for (size_t i = 0; i < length; ++i)
+            out[i] = match[i];
+        out += length;
+    }
+    return out == outEnd;
+}
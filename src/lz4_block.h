@@ -0,0 +1,13 @@
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <cstddef>
+#include <vector>
+
+// The LZ4 block format (no frame header, no checksums), enough for the entries of
+// an asset pack. The compressor is the plain greedy one: fast, not the smallest.
+std::vector<unsigned char> LZ4Compress(const unsigned char* source, size_t size);
+// false on malformed input or when the output is not exactly size bytes
+bool LZ4Decompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t size);
+
+#endif
@@ -1,50 +1,243 @@
 #include "particle_generator.h"
+#include "gl_state.h"
+#include "asset_pack.h"
 
-ParticleGenerator::ParticleGenerator(Shader shader, Texture2D texture, unsigned int amount)
-    : shader(shader), texture(texture), amount(amount)
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <sstream>
+
+ParticleGenerator::ParticleGenerator(Shader shader, TextureHandle texture, unsigned int capacity)
+    : UseGPU(false), Budget(capacity), capacity(capacity), stamp(1), clock(0.0f), shader(shader), texture(texture), current(0), cursor(0), gpuAvailable(false)
+{
+    this->init();
+}
+
+ParticleGenerator::ParticleGenerator(Shader shader, Shader updateShader, TextureHandle texture, unsigned int capacity)
+    : UseGPU(false), Budget(capacity), capacity(capacity), stamp(1), clock(0.0f), shader(shader), updateShader(updateShader), texture(texture), current(0), cursor(0), gpuAvailable(false)
 {
     this->init();
+    this->initGPU();
+    this->UseGPU = this->gpuAvailable;
 }
 
-void ParticleGenerator::Update(float dt, GameObject& object, unsigned int newParticles, glm::vec2 offset)
+ParticleGenerator::~ParticleGenerator()
 {
-    for (unsigned int i = 0; i < newParticles; ++i)
+    glDeleteVertexArrays(2, this->drawVAO);
+    glDeleteVertexArrays(2, this->updateVAO);
+    glDeleteBuffers(2, this->stateVBO);
+    glDeleteBuffers(1, &this->spawnVBO);
+    glDeleteBuffers(1, &this->quadVBO);
+    GLState::Invalidate();
+}
+
+void ParticleGenerator::LoadEmitters(const char* file)
+{
+    this->Emitters.clear();
+    std::string line;
+    AssetView source = AssetPack::Read(file);
+    if (!source)
     {
-        int unusedParticle = this->firstUnusedParticle();
-        this->respawnParticle(this->particles[unusedParticle], object, offset);
+        std::cout << "ERROR::PARTICLE: Failed to read emitter file " << file << std::endl;
+        return;
     }
+    std::istringstream fstream(source.Text());
+    while (std::getline(fstream, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream sstream(line);
+        EmitterType type;
+        if (sstream >> type.Name >> type.Count >> type.Life >> type.Speed >> type.Angle >> type.Spread
+                    >> type.Inherit >> type.Jitter >> type.Gravity.x >> type.Gravity.y >> type.Drag
+                    >> type.Fade >> type.Size >> type.Color.r >> type.Color.g >> type.Color.b
+                    >> type.ColorVariance >> type.Priority)
+        {
+            if (this->Emitters.size() == MAX_EMITTER_TYPES)
+            {
+                std::cout << "ERROR::PARTICLE: Too many emitter types, ignoring " << type.Name << std::endl;
+                continue;
+            }
+            this->Emitters.push_back(type);
+        }
+    }
+    this->uploadEmitters();
+}
 
-    for (unsigned int i = 0; i < this->amount; ++i)
+void ParticleGenerator::Emit(const char* name, glm::vec2 position, glm::vec2 velocity, glm::vec3 tint)
+{
+    for (unsigned int i = 0; i < this->Emitters.size(); ++i)
     {
-        Particle& p = this->particles[i];
-        p.Life -= dt;
-        if (p.Life > 0.0f)
-            p.Position -= p.Velocity * dt;
-        p.Color.a -= dt * 2.5f;
+        if (this->Emitters[i].Name == name)
+        {
+            this->allocate(i, position, velocity, tint);
+            return;
+        }
     }
 }
 
+void ParticleGenerator::Update(float dt)
+{
+    if (this->UseGPU)
+        this->updateGPU(dt);
+    else
+        this->updateCPU(dt);
+    this->spawns.clear();
+    this->spawnSlots.clear();
+    this->clock += dt;
+}
+
 void ParticleGenerator::Draw()
 {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE);
     this->shader.Use();
-    for (Particle particle : this->particles)
+    this->texture.Bind();
+    GLState::BindVertexArray(this->drawVAO[this->current]);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, this->capacity);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void ParticleGenerator::SetUseGPU(bool useGPU)
+{
+    useGPU = useGPU && this->gpuAvailable;
+    if (useGPU == this->UseGPU)
+        return;
+    // hand the live particles over so switching paths does not pop the trail
+    glBindBuffer(GL_ARRAY_BUFFER, this->stateVBO[this->current]);
+    if (useGPU)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, this->capacity * sizeof(Particle), this->particles.data());
+    else
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, this->capacity * sizeof(Particle), this->particles.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    this->UseGPU = useGPU;
+}
+
+void ParticleGenerator::SetBudget(unsigned int budget)
+{
+    // particles above a lowered budget are not killed, they just are not replaced
+    this->Budget = std::min(budget, this->capacity);
+    if (this->cursor >= this->Budget)
+        this->cursor = 0;
+}
+
+void ParticleGenerator::allocate(unsigned int emitter, glm::vec2 position, glm::vec2 velocity, glm::vec3 tint)
+{
+    const EmitterType& type = this->Emitters[emitter];
+    unsigned int budget = this->Budget;
+    unsigned int count = std::min(type.Count, budget);
+    if (count == 0)
+        return;
+
+    // free slots first, walking a ring so consecutive bursts stay contiguous
+    this->candidates.clear();
+    for (unsigned int n = 0; n < budget && this->candidates.size() < count; ++n)
+    {
+        unsigned int slot = (this->cursor + n) % budget;
+        if (this->slotDeath[slot] <= this->clock)
+            this->candidates.push_back(slot);
+    }
+    unsigned int found = this->candidates.size();
+
+    // pool exhausted: take over the lowest priority, oldest particles this one outranks or matches
+    if (found < count)
+    {
+        for (unsigned int slot = 0; slot < budget; ++slot)
+            if (this->slotDeath[slot] > this->clock && this->slotPriority[slot] <= type.Priority)
+                this->candidates.push_back(slot);
+        unsigned int needed = std::min(count - found, static_cast<unsigned int>(this->candidates.size()) - found);
+        std::vector<float>& death = this->slotDeath;
+        std::vector<unsigned int>& priority = this->slotPriority;
+        std::nth_element(this->candidates.begin() + found, this->candidates.begin() + found + needed, this->candidates.end(),
+            [&death, &priority](unsigned int a, unsigned int b) {
+                if (priority[a] != priority[b])
+                    return priority[a] < priority[b];
+                return death[a] < death[b];
+            });
+        this->candidates.resize(found + needed);
+    }
+    if (this->candidates.empty())
+        return;
+
+    // in slot order, so the CPU path draws its random numbers in a fixed order
+    std::sort(this->candidates.begin(), this->candidates.end());
+    ParticleSpawn spawn = { static_cast<unsigned int>(this->spawnSlots.size()), static_cast<unsigned int>(this->candidates.size()),
+        emitter, position, velocity, tint };
+    this->spawns.push_back(spawn);
+    for (unsigned int slot : this->candidates)
+    {
+        this->spawnSlots.push_back(slot);
+        this->slotDeath[slot] = this->clock + type.Life;
+        this->slotPriority[slot] = type.Priority;
+        this->cursor = (slot + 1) % budget;
+    }
+}
+
+void ParticleGenerator::updateCPU(float dt)
+{
+    for (const ParticleSpawn& spawn : this->spawns)
+        for (unsigned int i = 0; i < spawn.Count; ++i)
+            this->respawnParticle(this->particles[this->spawnSlots[spawn.First + i]], this->Emitters[spawn.Emitter], spawn);
+
+    for (unsigned int i = 0; i < this->capacity; ++i)
     {
-        if (particle.Life > 0.0f)
+        Particle& p = this->particles[i];
+        if (p.Life <= 0.0f)
+            continue;
+        const EmitterType& type = this->Emitters[static_cast<unsigned int>(p.Emitter)];
+        p.Life -= dt;
+        if (p.Life > 0.0f)
         {
-            this->shader.SetVector2f("offset", particle.Position);
-            this->shader.SetVector4f("color", particle.Color);
-            this->texture.Bind();
-            glBindVertexArray(this->VAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            glBindVertexArray(0);
+            p.Velocity += type.Gravity * dt;
+            p.Velocity *= std::max(0.0f, 1.0f - type.Drag * dt);
+            p.Position += p.Velocity * dt;
         }
+        p.Color.a -= dt * type.Fade;
     }
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glBindBuffer(GL_ARRAY_BUFFER, this->stateVBO[this->current]);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, this->capacity * sizeof(Particle), this->particles.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleGenerator::updateGPU(float dt)
+{
+    // only the slots spawned this frame are written, as one range around all of them
+    unsigned int low = this->capacity, high = 0;
+    for (const ParticleSpawn& spawn : this->spawns)
+    {
+        for (unsigned int i = 0; i < spawn.Count; ++i)
+        {
+            unsigned int slot = this->spawnSlots[spawn.First + i];
+            SlotSpawn data = { spawn.Position, spawn.Velocity, spawn.Tint, static_cast<int>(spawn.Emitter), this->stamp };
+            this->slotSpawns[slot] = data;
+            low = std::min(low, slot);
+            high = std::max(high, slot + 1);
+        }
+    }
+    if (low < high)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, this->spawnVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, low * sizeof(SlotSpawn), (high - low) * sizeof(SlotSpawn), &this->slotSpawns[low]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    this->updateShader.Use();
+    this->updateShader.SetFloat("dt", dt);
+    this->updateShader.SetFloat("seed", static_cast<float>(rand() % 10000));
+    this->updateShader.SetInteger("stamp", this->stamp++);
+
+    unsigned int next = 1 - this->current;
+    glEnable(GL_RASTERIZER_DISCARD);
+    GLState::BindVertexArray(this->updateVAO[this->current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, this->stateVBO[next]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, this->capacity);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    this->current = next;
 }
 
 void ParticleGenerator::init() {
-    unsigned int VBO;
     float particle_quad[] = {
         0.0f, 1.0f, 0.0f, 1.0f,
         1.0f, 0.0f, 1.0f, 0.0f,
@@ -54,44 +247,138 @@ void ParticleGenerator::init() {
         1.0f, 1.0f, 1.0f, 1.0f,
         1.0f, 0.0f, 1.0f, 0.0f
     };
-    glGenVertexArrays(1, &this->VAO);
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(this->VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    this->particles.resize(this->capacity);
+    this->slotDeath.resize(this->capacity, 0.0f);
+    this->slotPriority.resize(this->capacity, 0);
+    // reserved up front so bursts never allocate mid-game
+    this->candidates.reserve(this->capacity);
+    this->spawns.reserve(64);
+    this->spawnSlots.reserve(this->capacity);
+    this->slotSpawns.resize(this->capacity);
+
+    glGenBuffers(1, &this->quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glBindVertexArray(0);
 
-    for (unsigned int i = 0; i < this->amount; ++i)
-        this->particles.push_back(Particle());
+    glGenBuffers(2, this->stateVBO);
+    // stamp 0 in every slot, the first update uses 1
+    glGenBuffers(1, &this->spawnVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->spawnVBO);
+    glBufferData(GL_ARRAY_BUFFER, this->capacity * sizeof(SlotSpawn), this->slotSpawns.data(), GL_DYNAMIC_DRAW);
+    glGenVertexArrays(2, this->drawVAO);
+    glGenVertexArrays(2, this->updateVAO);
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, this->stateVBO[i]);
+        glBufferData(GL_ARRAY_BUFFER, this->capacity * sizeof(Particle), this->particles.data(), GL_DYNAMIC_COPY);
+
+        // one instanced quad per particle, dead particles collapse in the vertex shader
+        GLState::BindVertexArray(this->drawVAO[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, this->quadVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        glBindBuffer(GL_ARRAY_BUFFER, this->stateVBO[i]);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, Position));
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, Color));
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, Life));
+        glVertexAttribDivisor(3, 1);
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, Emitter));
+        glVertexAttribDivisor(4, 1);
+    }
+    GLState::BindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-unsigned int lastUsedParticle = 0;
-unsigned int ParticleGenerator::firstUnusedParticle()
+void ParticleGenerator::initGPU()
 {
-    for (unsigned int i = lastUsedParticle; i < this->amount; ++i) {
-        if (this->particles[i].Life <= 0.0f) {
-            lastUsedParticle = i;
-            return i;
-        }
+    if (!this->updateShader.Linked())
+    {
+        std::cout << "ERROR::PARTICLE: Update shader unavailable, simulating on the CPU" << std::endl;
+        return;
     }
-    for (unsigned int i = 0; i < lastUsedParticle; ++i) {
-        if (this->particles[i].Life <= 0.0f) {
-            lastUsedParticle = i;
-            return i;
-        }
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        GLState::BindVertexArray(this->updateVAO[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, this->stateVBO[i]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, Position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, Velocity));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, Color));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, Life));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, Emitter));
+        // both state buffers read the one spawn buffer
+        glBindBuffer(GL_ARRAY_BUFFER, this->spawnVBO);
+        glEnableVertexAttribArray(5);
+        glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, sizeof(SlotSpawn), (void*)offsetof(SlotSpawn, Position));
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 2, GL_FLOAT, GL_FALSE, sizeof(SlotSpawn), (void*)offsetof(SlotSpawn, Velocity));
+        glEnableVertexAttribArray(7);
+        glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(SlotSpawn), (void*)offsetof(SlotSpawn, Tint));
+        glEnableVertexAttribArray(8);
+        glVertexAttribIPointer(8, 2, GL_INT, sizeof(SlotSpawn), (void*)offsetof(SlotSpawn, Emitter));
     }
-    lastUsedParticle = 0;
-    return 0;
+    GLState::BindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    this->gpuAvailable = true;
+}
+
+void ParticleGenerator::uploadEmitters()
+{
+    float sizes[MAX_EMITTER_TYPES];
+    float params0[MAX_EMITTER_TYPES][4], params1[MAX_EMITTER_TYPES][4], params2[MAX_EMITTER_TYPES][4], colors[MAX_EMITTER_TYPES][3];
+    unsigned int count = this->Emitters.size();
+    if (count == 0)
+        return;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const EmitterType& type = this->Emitters[i];
+        sizes[i] = type.Size;
+        params0[i][0] = type.Life;
+        params0[i][1] = type.Speed;
+        params0[i][2] = glm::radians(type.Angle);
+        params0[i][3] = glm::radians(type.Spread);
+        params1[i][0] = type.Inherit;
+        params1[i][1] = type.Jitter;
+        params1[i][2] = type.Drag;
+        params1[i][3] = type.Fade;
+        params2[i][0] = type.Gravity.x;
+        params2[i][1] = type.Gravity.y;
+        params2[i][2] = type.ColorVariance;
+        params2[i][3] = 0.0f;
+        colors[i][0] = type.Color.r;
+        colors[i][1] = type.Color.g;
+        colors[i][2] = type.Color.b;
+    }
+    this->shader.Use();
+    glUniform1fv(this->shader.Location("sizes"), count, sizes);
+    if (!this->gpuAvailable)
+        return;
+    this->updateShader.Use();
+    glUniform4fv(this->updateShader.Location("emitterParams0"), count, (float*)params0);
+    glUniform4fv(this->updateShader.Location("emitterParams1"), count, (float*)params1);
+    glUniform4fv(this->updateShader.Location("emitterParams2"), count, (float*)params2);
+    glUniform3fv(this->updateShader.Location("emitterColor"), count, (float*)colors);
 }
 
-void ParticleGenerator::respawnParticle(Particle& particle, GameObject& object, glm::vec2 offset)
+void ParticleGenerator::respawnParticle(Particle& particle, const EmitterType& type, const ParticleSpawn& spawn)
 {
-    float random = ((rand() % 100) - 50) / 10.0f;
-    float rColor = 0.5f + ((rand() % 100) / 100.0f);
-    particle.Position = object.Position + random + offset;
-    particle.Color = glm::vec4(rColor, rColor, rColor, 1.0f);
-    particle.Life = 1.0f;
-    particle.Velocity = object.Velocity * 0.1f;
+    glm::vec2 jitter(((rand() % 100) - 50) / 50.0f, ((rand() % 100) - 50) / 50.0f);
+    float shade = 1.0f - type.ColorVariance + ((rand() % 100) / 100.0f) * 2.0f * type.ColorVariance;
+    float angle = glm::radians(type.Angle + ((rand() % 1000) / 1000.0f - 0.5f) * type.Spread);
+    float speed = type.Speed * (0.5f + (rand() % 100) / 200.0f);
+    particle.Position = spawn.Position + jitter * type.Jitter;
+    particle.Velocity = spawn.Velocity * type.Inherit + glm::vec2(cos(angle), sin(angle)) * speed;
+    particle.Color = glm::vec4(type.Color * spawn.Tint * shade, 1.0f);
+    particle.Life = type.Life;
+    particle.Emitter = static_cast<float>(spawn.Emitter);
 }
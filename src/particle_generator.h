@@ -1,5 +1,6 @@
 #ifndef PARTICLE_GENERATOR_H
 #define PARTICLE_GENERATOR_H
+#include <string>
 #include <vector>
 
 #include <glad/glad.h>
@@ -8,34 +9,105 @@
 #include "shader.h"
 #include "texture.h"
 #include "game_object.h"
+#include "resource_manager.h"
 
+// Must match the array sizes in particle.vs and particle_update.vs.
+const unsigned int MAX_EMITTER_TYPES = 8;
+
+// Layout is shared with the GPU state buffers, keep it tightly packed.
 struct Particle {
     glm::vec2 Position, Velocity;
     glm::vec4 Color;
     float     Life;
+    float     Emitter;
+
+    Particle() : Position(0.0f), Velocity(0.0f), Color(1.0f), Life(0.0f), Emitter(0.0f) { }
+};
+
+// One named emitter, loaded from resources/particles/emitters.txt.
+struct EmitterType {
+    std::string  Name;
+    unsigned int Count;
+    float        Life, Speed, Angle, Spread, Inherit, Jitter;
+    glm::vec2    Gravity;
+    float        Drag, Fade, Size;
+    glm::vec3    Color;
+    float        ColorVariance;
+    unsigned int Priority;
+};
 
-    Particle() : Position(0.0f), Velocity(0.0f), Color(1.0f), Life(0.0f) { }
+// One Emit this frame: the slots it took are spawnSlots[First] to spawnSlots[First + Count - 1].
+struct ParticleSpawn {
+    unsigned int First, Count, Emitter;
+    glm::vec2    Position, Velocity;
+    glm::vec3    Tint;
+};
+
+// Spawn data of one pool slot, read by particle_update.vs as vertex attributes; the
+// slot respawns in the update whose stamp matches, so nothing has to be cleared.
+struct SlotSpawn {
+    glm::vec2 Position, Velocity;
+    glm::vec3 Tint;
+    int       Emitter;
+    int       Stamp;
 };
 
 class ParticleGenerator
 {
 public:
-    ParticleGenerator(Shader shader, Texture2D texture, unsigned int amount);
-    void Update(float dt, GameObject& object, unsigned int newParticles, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
+    // true while particles are simulated with transform feedback
+    bool UseGPU;
+    // live particle limit shared by every emitter, never above the pool capacity
+    unsigned int Budget;
+    std::vector<EmitterType> Emitters;
+
+    ParticleGenerator(Shader shader, TextureHandle texture, unsigned int capacity);
+    ParticleGenerator(Shader shader, Shader updateShader, TextureHandle texture, unsigned int capacity);
+    ~ParticleGenerator();
+    void LoadEmitters(const char* file);
+    void Emit(const char* name, glm::vec2 position, glm::vec2 velocity = glm::vec2(0.0f), glm::vec3 tint = glm::vec3(1.0f));
+    void Update(float dt);
     void Draw();
+    void SetUseGPU(bool useGPU);
+    void SetBudget(unsigned int budget);
+    unsigned int Capacity() const { return this->capacity; }
 private:
     std::vector<Particle> particles;
-    unsigned int amount;
+    unsigned int capacity;
+    // CPU shadow of every slot so both paths allocate without reading back
+    std::vector<float> slotDeath;
+    std::vector<unsigned int> slotPriority;
+    std::vector<unsigned int> candidates;
+    std::vector<ParticleSpawn> spawns;
+    std::vector<unsigned int> spawnSlots;
+    // CPU copy of the spawn buffer, only the slots written this frame are uploaded
+    std::vector<SlotSpawn> slotSpawns;
+    int stamp;
+    float clock;
 
     Shader shader;
-    Texture2D texture;
-    unsigned int VAO;
+    Shader updateShader;
+    TextureHandle texture;
+    unsigned int quadVBO;
+    // ping-pong particle state, current holds the latest simulated frame
+    unsigned int stateVBO[2];
+    unsigned int spawnVBO;
+    unsigned int drawVAO[2];
+    unsigned int updateVAO[2];
+    unsigned int current;
+    unsigned int cursor;
+    bool gpuAvailable;
 
     void init();
+    void initGPU();
+    void uploadEmitters();
+
+    void updateCPU(float dt);
+    void updateGPU(float dt);
 
-    unsigned int firstUnusedParticle();
+    void allocate(unsigned int emitter, glm::vec2 position, glm::vec2 velocity, glm::vec3 tint);
 
-    void respawnParticle(Particle& particle, GameObject& object, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
+    void respawnParticle(Particle& particle, const EmitterType& type, const ParticleSpawn& spawn);
 };
 
 #endif
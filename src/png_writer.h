@@ -0,0 +1,9 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+// Writes 8 bit RGBA pixels as a PNG. The image data is stored uncompressed inside
+// the deflate stream, so files are large but any decoder reads them back bit exact.
+// rows are bottom to top when flip is set, as glReadPixels returns them.
+bool WritePNG(const char* path, unsigned int width, unsigned int height, const unsigned char* pixels, bool flip = true);
+
+#endif
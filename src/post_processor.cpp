@@ -1,87 +1,216 @@
 #include "post_processor.h"
+#include "gl_state.h"
+#include "resource_manager.h"
 
+#include <algorithm>
 #include <iostream>
 
-PostProcessor::PostProcessor(Shader shader, unsigned int width, unsigned int height)
-    : PostProcessingShader(shader), Texture(), Width(width), Height(height), Confuse(false), Chaos(false), Shake(false) 
+PostProcessor::PostProcessor(const char* vShaderFile, const char* fShaderFile, unsigned int samples)
+    : Confuse(false), Chaos(false), Shake(false), Bloom(true), BloomThreshold(0.7f), BloomIntensity(0.8f), BloomDivisor(2), FXAA(FXAA_OFF), Samples(0), maxSamples(0), vertexFile(vShaderFile), fragmentFile(fShaderFile), bypass(false)
 {
-    glGenFramebuffers(1, &this->MSFBO);
-    glGenFramebuffers(1, &this->FBO);
-    glGenRenderbuffers(1, &this->RBO);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, this->MSFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, this->RBO);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_RGB, width, height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->RBO);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "ERROR::POSTPROCESSOR: Failed to initialize MSFBO" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
-    this->Texture.Generate(width, height, NULL);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->Texture.ID, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "ERROR::POSTPROCESSOR: Failed to initialize FBO" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    int maxSamples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    this->maxSamples = static_cast<unsigned int>(maxSamples);
+    this->SetSamples(samples);
     this->initRenderData();
-    this->PostProcessingShader.SetInteger("scene", 0, true);
-    float offset = 1.0f / 300.0f;
-    float offsets[9][2] = {
-        { -offset,  offset  },  // top-left
-        {  0.0f,    offset  },  // top-center
-        {  offset,  offset  },  // top-right
-        { -offset,  0.0f    },  // center-left
-        {  0.0f,    0.0f    },  // center-center
-        {  offset,  0.0f    },  // center - right
-        { -offset, -offset  },  // bottom-left
-        {  0.0f,   -offset  },  // bottom-center
-        {  offset, -offset  }   // bottom-right    
-    };
-    glUniform2fv(glGetUniformLocation(this->PostProcessingShader.ID, "offsets"), 9, (float*)offsets);
-    int edge_kernel[9] = {
-        -1, -1, -1,
-        -1,  8, -1,
-        -1, -1, -1
-    };
-    glUniform1iv(glGetUniformLocation(this->PostProcessingShader.ID, "edge_kernel"), 9, edge_kernel);
-    float blur_kernel[9] = {
-        1.0f / 16.0f, 2.0f / 16.0f, 1.0f / 16.0f,
-        2.0f / 16.0f, 4.0f / 16.0f, 2.0f / 16.0f,
-        1.0f / 16.0f, 2.0f / 16.0f, 1.0f / 16.0f
-    };
-    glUniform1fv(glGetUniformLocation(this->PostProcessingShader.ID, "blur_kernel"), 9, blur_kernel);
+    this->bloomExtract = ResourceManager::LoadShader(this->vertexFile.c_str(), "shaders/bloom_extract.frag", nullptr, "bloom_extract");
+    this->bloomExtract.SetInteger("image", 0, true);
+    this->bloomBlur = ResourceManager::LoadShader(this->vertexFile.c_str(), "shaders/bloom_blur.frag", nullptr, "bloom_blur");
+    this->bloomBlur.SetInteger("image", 0, true);
+}
+
+PostProcessor::~PostProcessor()
+{
+    glDeleteVertexArrays(1, &this->VAO);
+    glDeleteBuffers(1, &this->VBO);
+    GLState::Invalidate();
+}
+
+void PostProcessor::SetSamples(unsigned int samples)
+{
+    // the multisample target itself comes from the render graph on the next frame
+    samples = std::min(samples, this->maxSamples);
+    this->Samples = samples >= 8 ? 8 : samples >= 4 ? 4 : samples >= 2 ? 2 : 0;
+}
+
+bool PostProcessor::Active() const
+{
+    return this->Confuse || this->Chaos || this->Shake || this->Bloom || this->FXAA != FXAA_OFF;
 }
 
-void PostProcessor::BeginRender()
+void PostProcessor::Apply(const PostSettings& settings)
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, this->MSFBO);
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    this->Confuse = settings.Confuse;
+    this->Chaos = settings.Chaos;
+    this->Shake = settings.Shake;
+    this->Bloom = settings.Bloom;
+    this->FXAA = settings.FXAA;
+    if (settings.Samples != this->Samples)
+        this->SetSamples(settings.Samples);
+}
+
+unsigned int PostProcessor::SceneTarget(RenderGraph& graph)
+{
+    // with no effect the intermediate texture and the full-screen pass are skipped,
+    // the scene is drawn (or resolved) straight into the back buffer unless it still
+    // has to be scaled to the output size
+    this->bypass = !this->Active();
+    if (this->Samples > 0)
+    {
+        RenderTargetDesc desc = { graph.Width(), graph.Height(), GL_RGBA8, this->Samples };
+        return graph.CreateTarget("scene_msaa", desc);
+    }
+    if (this->bypass && !this->scaled(graph))
+        return RenderGraph::BACKBUFFER;
+    RenderTargetDesc desc = { graph.Width(), graph.Height(), GL_RGBA8, 0 };
+    return graph.CreateTarget("scene", desc);
+}
+
+void PostProcessor::AddPasses(RenderGraph& graph, unsigned int scene)
+{
+    RenderGraph* frame = &graph;
+    bool scaled = this->scaled(graph);
+    // RGBA8 like the back buffer, a multisample resolve cannot convert formats
+    RenderTargetDesc desc = { graph.Width(), graph.Height(), GL_RGBA8, 0 };
+    // everything up to here runs at the render resolution, output is what gets upscaled
+    unsigned int output = scaled ? graph.CreateTarget("output", desc) : RenderGraph::BACKBUFFER;
+    unsigned int resolved = scene;
+    if (this->Samples > 0)
+    {
+        resolved = this->bypass ? output : graph.CreateTarget("scene", desc);
+        graph.AddPass("resolve", { scene }, resolved, [frame, scene, resolved]() {
+            frame->Blit(scene, resolved, GL_NEAREST);
+        });
+    }
+
+    if (this->bypass)
+        output = resolved;
+    else
+    {
+        unsigned int effects = (this->Chaos ? EFFECT_CHAOS : 0) | (this->Confuse ? EFFECT_CONFUSE : 0) | (this->Shake ? EFFECT_SHAKE : 0);
+        if (this->FXAA != FXAA_OFF)
+            effects |= EFFECT_FXAA_LOW << (this->FXAA - FXAA_LOW);
+        if (!this->Bloom)
+        {
+            graph.AddPass("final", { resolved }, output, [this, frame, resolved, effects]() {
+                this->permutation(effects).Use();
+                frame->BindTexture(resolved, 0);
+                this->drawQuad();
+            });
+        }
+        else
+        {
+            unsigned int bloomHalf, bloomQuarter;
+            this->addBloom(graph, resolved, bloomHalf, bloomQuarter);
+            effects |= EFFECT_BLOOM;
+            graph.AddPass("final", { resolved, bloomHalf, bloomQuarter }, output, [this, frame, resolved, bloomHalf, bloomQuarter, effects]() {
+                Shader& shader = this->permutation(effects);
+                shader.Use();
+                shader.SetFloat("bloomIntensity", this->BloomIntensity);
+                frame->BindTexture(bloomHalf, 1);
+                frame->BindTexture(bloomQuarter, 2);
+                frame->BindTexture(resolved, 0);
+                this->drawQuad();
+            });
+        }
+    }
+
+    if (scaled)
+    {
+        // bilinear, above 1.0 render scale this averages the supersampled pixels down
+        graph.AddPass("upscale", { output }, RenderGraph::BACKBUFFER, [frame, output]() {
+            frame->Blit(output, RenderGraph::BACKBUFFER, GL_LINEAR);
+        });
+    }
+}
+
+bool PostProcessor::scaled(const RenderGraph& graph) const
+{
+    return graph.Width() != graph.OutputWidth() || graph.Height() != graph.OutputHeight();
+}
+
+Shader& PostProcessor::permutation(unsigned int effects)
+{
+    std::map<unsigned int, Shader>::iterator found = this->permutations.find(effects);
+    if (found != this->permutations.end())
+        return found->second;
+
+    // compiled the first time a combination shows up, then reused for the rest of the run
+    std::string defines;
+    if (effects & EFFECT_CHAOS)
+        defines += "#define CHAOS\n";
+    if (effects & EFFECT_CONFUSE)
+        defines += "#define CONFUSE\n";
+    if (effects & EFFECT_SHAKE)
+        defines += "#define SHAKE\n";
+    if (effects & EFFECT_BLOOM)
+        defines += "#define BLOOM\n";
+    if (effects & EFFECT_FXAA_LOW)
+        defines += "#define FXAA 1\n";
+    else if (effects & EFFECT_FXAA_MEDIUM)
+        defines += "#define FXAA 2\n";
+    else if (effects & EFFECT_FXAA_HIGH)
+        defines += "#define FXAA 3\n";
+    std::string name = "postprocessing_" + std::to_string(effects);
+    Shader shader = ResourceManager::LoadShader(this->vertexFile.c_str(), this->fragmentFile.c_str(), nullptr, name, defines);
+    shader.SetInteger("scene", 0, true);
+    if (effects & EFFECT_BLOOM)
+    {
+        shader.SetInteger("bloomHalf", 1);
+        shader.SetInteger("bloomQuarter", 2);
+    }
+    return this->permutations[effects] = shader;
+}
+
+void PostProcessor::addBloom(RenderGraph& graph, unsigned int scene, unsigned int& half, unsigned int& quarter)
+{
+    // every pass works on a fraction of the screen, so the cost tracks the resolution
+    // as a fixed share of the frame instead of the blur radius; half float keeps the
+    // faint tail of the blur from banding
+    unsigned int divisor = std::max(this->BloomDivisor, 1u);
+    RenderTargetDesc halfDesc = { std::max(graph.Width() / divisor, 1u), std::max(graph.Height() / divisor, 1u), GL_RGBA16F, 0 };
+    RenderTargetDesc quarterDesc = { std::max(graph.Width() / (divisor * 2), 1u), std::max(graph.Height() / (divisor * 2), 1u), GL_RGBA16F, 0 };
+    unsigned int bright = graph.CreateTarget("bloom_bright", halfDesc);
+    unsigned int halfH = graph.CreateTarget("bloom_half_h", halfDesc);
+    half = graph.CreateTarget("bloom_half", halfDesc);
+    unsigned int quarterH = graph.CreateTarget("bloom_quarter_h", quarterDesc);
+    quarter = graph.CreateTarget("bloom_quarter", quarterDesc);
+
+    RenderGraph* frame = &graph;
+    graph.AddPass("bloom_extract", { scene }, bright, [this, frame, scene, divisor]() {
+        this->bloomExtract.Use();
+        this->bloomExtract.SetVector2f("texel", 1.0f / frame->Width(), 1.0f / frame->Height());
+        this->bloomExtract.SetFloat("block", static_cast<float>(divisor));
+        this->bloomExtract.SetFloat("threshold", this->BloomThreshold);
+        frame->BindTexture(scene, 0);
+        this->drawQuad();
+    });
+    this->blurPass(graph, "bloom_blur_h", bright, halfH, glm::vec2(1.0f / halfDesc.Width, 0.0f));
+    this->blurPass(graph, "bloom_blur_v", halfH, half, glm::vec2(0.0f, 1.0f / halfDesc.Height));
+    // the horizontal blur of the half level doubles as the downsample to quarter
+    this->blurPass(graph, "bloom_quarter_h", half, quarterH, glm::vec2(1.0f / halfDesc.Width, 0.0f));
+    this->blurPass(graph, "bloom_quarter_v", quarterH, quarter, glm::vec2(0.0f, 1.0f / quarterDesc.Height));
 }
 
-void PostProcessor::EndRender()
+void PostProcessor::blurPass(RenderGraph& graph, const char* name, unsigned int source, unsigned int target, glm::vec2 direction)
 {
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, this->MSFBO);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->FBO);
-    glBlitFramebuffer(0, 0, this->Width, this->Height, 0, 0, this->Width, this->Height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    RenderGraph* frame = &graph;
+    graph.AddPass(name, { source }, target, [this, frame, source, direction]() {
+        this->bloomBlur.Use();
+        this->bloomBlur.SetVector2f("direction", direction);
+        frame->BindTexture(source, 0);
+        this->drawQuad();
+    });
 }
 
-void PostProcessor::Render(float time)
+void PostProcessor::drawQuad()
 {
-    this->PostProcessingShader.Use();
-    this->PostProcessingShader.SetFloat("time", time);
-    this->PostProcessingShader.SetInteger("confuse", this->Confuse);
-    this->PostProcessingShader.SetInteger("chaos", this->Chaos);
-    this->PostProcessingShader.SetInteger("shake", this->Shake);
-    glActiveTexture(GL_TEXTURE0);
-    this->Texture.Bind();
-    glBindVertexArray(this->VAO);
+    GLState::BindVertexArray(this->VAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
 }
 
 void PostProcessor::initRenderData()
 {
-    unsigned int VBO;
     float vertices[] = {
         -1.0f, -1.0f, 0.0f, 0.0f,
          1.0f,  1.0f, 1.0f, 1.0f,
@@ -92,14 +221,14 @@ void PostProcessor::initRenderData()
          1.0f,  1.0f, 1.0f, 1.0f
     };
     glGenVertexArrays(1, &this->VAO);
-    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &this->VBO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindVertexArray(this->VAO);
+    GLState::BindVertexArray(this->VAO);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState::BindVertexArray(0);
 }
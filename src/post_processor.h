@@ -1,28 +1,85 @@
 #ifndef POST_PROCESSOR_H
 #define POST_PROCESSOR_H
 
+#include <map>
+#include <string>
+
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include "texture.h"
 #include "sprite_renderer.h"
 #include "shader.h"
+#include "render_graph.h"
+
+// Bits of a post-processing permutation, each one is a #define in final.vs/final.frag.
+enum PostEffect {
+	EFFECT_CHAOS   = 1,
+	EFFECT_CONFUSE = 2,
+	EFFECT_SHAKE   = 4,
+	EFFECT_BLOOM   = 8,
+	// one bit per FXAA preset
+	EFFECT_FXAA_LOW    = 16,
+	EFFECT_FXAA_MEDIUM = 32,
+	EFFECT_FXAA_HIGH   = 64
+};
+
+enum FXAAPreset {
+	FXAA_OFF,
+	FXAA_LOW,
+	FXAA_MEDIUM,
+	FXAA_HIGH
+};
+
+// The effect switches as plain data, so the simulation can set them without touching
+// the PostProcessor; applied once per frame on the GL thread.
+struct PostSettings {
+	bool Confuse, Chaos, Shake, Bloom;
+	FXAAPreset FXAA;
+	unsigned int Samples;
+};
 
 class PostProcessor
 {
 public:
-	Shader PostProcessingShader;
-	Texture2D Texture;
-	unsigned int Width, Height;
 	bool Confuse, Chaos, Shake;
-	PostProcessor(Shader shader, unsigned int width, unsigned int height);
-	void BeginRender();
-	void EndRender();
-	void Render(float time);
+	// glow around everything brighter than BloomThreshold, blurred at half and quarter resolution
+	bool Bloom;
+	float BloomThreshold, BloomIntensity;
+	// 2 blurs at half and quarter resolution, 4 at a quarter and an eighth for a fraction of the cost
+	unsigned int BloomDivisor;
+	// post-process anti-aliasing inside the final pass, much cheaper in bandwidth than MSAA
+	FXAAPreset FXAA;
+	// MSAA sample count of the scene, 0 renders without multisampling
+	unsigned int Samples;
+	// the effect shaders are built from these files, one permutation per combination of effects
+	PostProcessor(const char* vShaderFile, const char* fShaderFile, unsigned int samples = 4);
+	~PostProcessor();
+	// 0, 2, 4 or 8, other values round down and are clamped to what the driver supports
+	void SetSamples(unsigned int samples);
+	// true when a frame needs the full-screen effect pass
+	bool Active() const;
+	void Apply(const PostSettings& settings);
+	// the target the scene is drawn into this frame, the back buffer itself when there is
+	// nothing to resolve or post-process
+	unsigned int SceneTarget(RenderGraph& graph);
+	// resolve, bloom, the final pass and, when the render resolution differs from the
+	// output, the upscale from scene to the back buffer
+	void AddPasses(RenderGraph& graph, unsigned int scene);
 private:
-	unsigned int MSFBO, FBO;
-	unsigned int RBO;
-	unsigned int VAO;
+	unsigned int VAO, VBO;
+	unsigned int maxSamples;
+	Shader bloomExtract, bloomBlur;
+	std::string vertexFile, fragmentFile;
+	// keyed by PostEffect mask, stacked effects share one pass
+	std::map<unsigned int, Shader> permutations;
+	// latched in SceneTarget: no effect this frame, the scene goes to the back buffer
+	bool bypass;
+	bool scaled(const RenderGraph& graph) const;
+	Shader& permutation(unsigned int effects);
+	void addBloom(RenderGraph& graph, unsigned int scene, unsigned int& half, unsigned int& quarter);
+	void blurPass(RenderGraph& graph, const char* name, unsigned int source, unsigned int target, glm::vec2 direction);
+	void drawQuad();
 	void initRenderData();
 };
 
@@ -17,7 +17,7 @@ public:
 	float       Duration;
 	bool        Activated;
 
-	PowerUp(std::string type, glm::vec3 color, float duration, glm::vec2 position, Texture2D texture)
+	PowerUp(std::string type, glm::vec3 color, float duration, glm::vec2 position, TextureHandle texture)
 		: GameObject(position, POWERUP_SIZE, texture, color, VELOCITY), Type(type), Duration(duration), Activated() { }
 };
 
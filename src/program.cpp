@@ -3,24 +3,61 @@
 
 #include "game.h"
 #include "resource_manager.h"
+#include "frame_pipeline.h"
+#include "frame_pacer.h"
+#include "headless.h"
+#include "asset_pack.h"
 
+#include <algorithm>
 #include <iostream>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void window_refresh_callback(GLFWwindow* window);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
+void window_pos_callback(GLFWwindow* window, int x, int y);
+void toggle_fullscreen(GLFWwindow* window);
+void update_frame_budget(GLFWwindow* window);
 
 const unsigned int SCREEN_WIDTH = 800;
 const unsigned int SCREEN_HEIGHT = 600;
+// a packed build ships this next to the executable instead of resources/ and shaders/
+const char* ASSET_PACK = "assets.pak";
+// upper bound with vsync off, with vsync on the display refresh rate paces first
+const double FRAME_RATE_LIMIT = 144.0;
+// longest a static frame blocks for events before looking at the window again
+const double IDLE_WAIT = 0.5;
 
 Game Breakout(SCREEN_WIDTH, SCREEN_HEIGHT);
 
+// written by the key callback, handed to the simulation thread once per frame
+bool InputKeys[1024];
+bool InputReleased[1024];
+// set by the callbacks, a static frame on screen is only redrawn or re-presented after one of these
+bool InputPending, ResizePending, RefreshPending;
+
+FramePacer Pacer(FRAME_RATE_LIMIT);
+
 int main(int argc, char* argv[]) {
+    // without a pack everything is read from the loose files
+    AssetPack::Open(ASSET_PACK);
+
+    // --headless renders a scripted session offscreen, see headless.h
+    HeadlessOptions headless;
+    if (ParseHeadlessOptions(argc, argv, headless))
+    {
+        int result = RunHeadless(Breakout, headless);
+        AssetPack::Close();
+        return result;
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    glfwWindowHint(GLFW_RESIZABLE, false);
+    glfwWindowHint(GLFW_RESIZABLE, true);
+    // on HiDPI monitors the window is enlarged by the content scale, the framebuffer follows
+    glfwWindowHint(GLFW_SCALE_TO_MONITOR, true);
 
     GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Breakout", nullptr, nullptr);
     glfwMakeContextCurrent(window);
@@ -30,38 +67,83 @@ int main(int argc, char* argv[]) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    Shader::LoadExtensions((GLADloadproc)glfwGetProcAddress);
 
     glfwSetKeyCallback(window, key_callback);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    glfwSetWindowPosCallback(window, window_pos_callback);
+    Pacer.SetVSync(true);
 
-    glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     Breakout.Init();
+    // edited shaders are rebuilt while the game runs; a pack is read only, nothing to watch
+    if (!AssetPack::IsOpen())
+        ResourceManager::WatchShaders();
+    // the framebuffer is not SCREEN_WIDTH x SCREEN_HEIGHT pixels on HiDPI displays
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    Breakout.Resize(framebufferWidth, framebufferHeight);
+    update_frame_budget(window);
 
     float deltaTime = 0.0f;
     float lastFrame = 0.0f;
 
-    while (!glfwWindowShouldClose(window))
     {
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-        glfwPollEvents();
-
-        Breakout.ProcessInput(deltaTime);
-
-        Breakout.Update(deltaTime);
-
-        glClearColor(0.0f, 0.15f, 0.25f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        Breakout.Render();
-
-        glfwSwapBuffers(window);
+        // simulation runs one frame ahead on a worker thread, this thread only draws
+        FramePipeline pipeline(Breakout);
+        // submitted frames in a row that were static with no input in between, the frame
+        // after an input was simulated before it, so it takes two before the loop may sleep
+        unsigned int staticFrames = 0;
+        while (!glfwWindowShouldClose(window))
+        {
+            if (staticFrames >= 2)
+            {
+                // the cached frame stays on screen, block instead of drawing it again
+                glfwWaitEventsTimeout(IDLE_WAIT);
+                // a reloaded shader changes the picture, the frame is drawn again
+                bool reloaded = ResourceManager::ReloadShaders() > 0;
+                if (!InputPending && !ResizePending && !reloaded)
+                {
+                    if (RefreshPending)
+                    {
+                        Breakout.PresentCachedFrame();
+                        glfwSwapBuffers(window);
+                        RefreshPending = false;
+                    }
+                    continue;
+                }
+                staticFrames = 0;
+                // the time spent waiting must not reach the simulation as one step
+                lastFrame = glfwGetTime();
+                Pacer.Restart();
+            }
+
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+            glfwPollEvents();
+            ResourceManager::ReloadShaders();
+
+            glClearColor(0.0f, 0.15f, 0.25f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            pipeline.Frame(deltaTime, InputKeys, InputReleased);
+
+            staticFrames = Breakout.FrameIsStatic() && !InputPending && !ResizePending ? staticFrames + 1 : 0;
+            InputPending = ResizePending = RefreshPending = false;
+            if (staticFrames >= 2)
+                Breakout.CacheFrame();
+
+            glfwSwapBuffers(window);
+            Pacer.Wait();
+        }
     }
 
+    Breakout.Shutdown();
     ResourceManager::Clear();
+    AssetPack::Close();
 
     glfwTerminate();
     return 0;
@@ -71,18 +153,93 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+    if (key == GLFW_KEY_F11 && action == GLFW_PRESS)
+        toggle_fullscreen(window);
+    if (key == GLFW_KEY_V && action == GLFW_PRESS)
+        Pacer.SetVSync(!Pacer.VSync());
+    InputPending = true;
     if (key >= 0 && key < 1024)
     {
         if (action == GLFW_PRESS)
-            Breakout.Keys[key] = true;
+            InputKeys[key] = true;
         else if (action == GLFW_RELEASE) {
-            Breakout.Keys[key] = false;
-            Breakout.KeysProcessed[key] = false;
+            InputKeys[key] = false;
+            InputReleased[key] = true;
         }
     }
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+    // called on this thread from glfwPollEvents, between two frames
     glViewport(0, 0, width, height);
+    Breakout.Resize(width, height);
+    ResizePending = true;
+}
+
+void window_refresh_callback(GLFWwindow* window)
+{
+    // the window was uncovered or damaged, while idle the cached frame is presented again
+    RefreshPending = true;
+}
+
+void window_pos_callback(GLFWwindow* window, int x, int y)
+{
+    // the window may have moved onto a monitor with another refresh rate
+    update_frame_budget(window);
+}
+
+void toggle_fullscreen(GLFWwindow* window)
+{
+    static int windowedX, windowedY, windowedWidth, windowedHeight;
+    if (glfwGetWindowMonitor(window))
+    {
+        glfwSetWindowMonitor(window, nullptr, windowedX, windowedY, windowedWidth, windowedHeight, 0);
+        update_frame_budget(window);
+        return;
+    }
+    glfwGetWindowPos(window, &windowedX, &windowedY);
+    glfwGetWindowSize(window, &windowedWidth, &windowedHeight);
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+    glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
+    update_frame_budget(window);
+}
+
+// the monitor showing the window: its fullscreen monitor, else the one under the window's center
+static GLFWmonitor* window_monitor(GLFWwindow* window)
+{
+    if (GLFWmonitor* fullscreen = glfwGetWindowMonitor(window))
+        return fullscreen;
+    int x, y, width, height, count;
+    glfwGetWindowPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    x += width / 2;
+    y += height / 2;
+    GLFWmonitor** monitors = glfwGetMonitors(&count);
+    for (int i = 0; i < count; ++i)
+    {
+        const GLFWvidmode* mode = glfwGetVideoMode(monitors[i]);
+        int left, top;
+        glfwGetMonitorPos(monitors[i], &left, &top);
+        if (mode && x >= left && x < left + mode->width && y >= top && y < top + mode->height)
+            return monitors[i];
+    }
+    return glfwGetPrimaryMonitor();
+}
+
+// quality steps down while frames miss the rate they are shown at: the monitor's refresh,
+// or the pacer's limit when that is lower, frames faster than it are only waited out
+void update_frame_budget(GLFWwindow* window)
+{
+    static float budget = 0.0f;
+    const GLFWvidmode* mode = glfwGetVideoMode(window_monitor(window));
+    double rate = mode && mode->refreshRate > 0 ? mode->refreshRate : 60.0;
+    if (Pacer.TargetFPS() > 0.0)
+        rate = std::min(rate, Pacer.TargetFPS());
+    // moving the window calls this over and over, the governor restarts only on a change
+    if (static_cast<float>(1000.0 / rate) == budget)
+        return;
+    budget = static_cast<float>(1000.0 / rate);
+    Breakout.SetFrameBudget(budget);
 }
\ No newline at end of file
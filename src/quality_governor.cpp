@@ -0,0 +1,138 @@
+#include "quality_governor.h"
+
+#include <algorithm>
+#include <iostream>
+
+// cumulative, each level gives up one more thing than the one before; supersampling
+// goes first, the render scale below 1 last since it blurs everything
+const QualityLimits LEVELS[] = {
+    { "full quality",                2.0f,  8, 2, 1.0f  },
+    { "render scale 1 at most",      1.0f,  8, 2, 1.0f  },
+    { "half the particles",          1.0f,  8, 2, 0.5f  },
+    { "MSAA 2x at most",             1.0f,  2, 2, 0.5f  },
+    { "bloom at quarter resolution", 1.0f,  2, 4, 0.5f  },
+    { "no MSAA",                     1.0f,  0, 4, 0.5f  },
+    { "a quarter of the particles",  1.0f,  0, 4, 0.25f },
+    { "render scale 0.75",           0.75f, 0, 4, 0.25f },
+    { "render scale 0.5",            0.5f,  0, 4, 0.25f },
+};
+const unsigned int LEVEL_COUNT = sizeof(LEVELS) / sizeof(LEVELS[0]);
+// shares of the budget: above the first steps down, below the second counts as calm
+const float STEP_DOWN = 0.9f;
+const float STEP_UP = 0.6f;
+const unsigned int CALM_WINDOWS = 3;
+// a level that keeps failing is retried at most this rarely
+const unsigned int MAX_CALM_WINDOWS = 48;
+// more than RenderGraph::TIMING_LATENCY, the frames GPU times lag behind
+const unsigned int SETTLE_FRAMES = 8;
+
+QualityGovernor::QualityGovernor()
+    : budget(0.0f), level(0), cpuTotal(0.0f), gpuTotal(0.0f), count(0), settle(0), calm(0),
+      calmNeeded(LEVEL_COUNT, CALM_WINDOWS), sinceUp(CALM_WINDOWS), settings(LEVELS[0])
+{
+}
+
+void QualityGovernor::SetBudget(float budget)
+{
+    this->budget = std::max(budget, 0.0f);
+    this->cpuTotal = this->gpuTotal = 0.0f;
+    this->count = 0;
+    this->calm = 0;
+    std::fill(this->calmNeeded.begin(), this->calmNeeded.end(), CALM_WINDOWS);
+    this->sinceUp = CALM_WINDOWS;
+    if (this->budget == 0.0f && this->level != 0)
+        this->step(0, 0.0f, 0.0f);
+}
+
+void QualityGovernor::SetSettings(float renderScale, unsigned int samples, bool bloom)
+{
+    this->settings.RenderScale = renderScale;
+    this->settings.Samples = samples;
+    // without bloom its resolution costs nothing
+    this->settings.BloomDivisor = bloom ? 1 : 0;
+}
+
+bool QualityGovernor::Update(float cpuTime, float gpuTime)
+{
+    if (this->budget == 0.0f)
+        return false;
+    if (this->settle > 0)
+    {
+        this->settle--;
+        return false;
+    }
+    this->cpuTotal += cpuTime;
+    this->gpuTotal += gpuTime;
+    if (++this->count < WINDOW)
+        return false;
+
+    float cpu = this->cpuTotal / WINDOW, gpu = this->gpuTotal / WINDOW;
+    this->cpuTotal = this->gpuTotal = 0.0f;
+    this->count = 0;
+    if (this->sinceUp < CALM_WINDOWS && ++this->sinceUp == CALM_WINDOWS)
+        this->calmNeeded[this->level] = CALM_WINDOWS;
+    // the slower side sets the frame rate, simulation and rendering overlap
+    float cost = std::max(cpu, gpu);
+    if (cost > this->budget * STEP_DOWN)
+    {
+        this->calm = 0;
+        // the first level down that gives something up
+        unsigned int down = this->level + 1;
+        while (down < LEVEL_COUNT && this->same(down, this->level))
+            ++down;
+        if (down < LEVEL_COUNT)
+        {
+            if (this->sinceUp < CALM_WINDOWS)
+                this->calmNeeded[this->level] = std::min(this->calmNeeded[this->level] * 2, MAX_CALM_WINDOWS);
+            this->step(down, cpu, gpu);
+            this->sinceUp = CALM_WINDOWS;
+            return true;
+        }
+    }
+    else if (cost < this->budget * STEP_UP)
+    {
+        // the first level up that gets something back, and the highest quality level
+        // that gets no more than that
+        unsigned int up = this->level;
+        while (up > 0 && this->same(up - 1, this->level))
+            --up;
+        if (up > 0)
+            --up;
+        while (up > 0 && this->same(up - 1, up))
+            --up;
+        if (up != this->level && ++this->calm >= this->calmNeeded[up])
+        {
+            this->calm = 0;
+            this->step(up, cpu, gpu);
+            this->sinceUp = 0;
+            return true;
+        }
+    }
+    else
+        this->calm = 0;
+    return false;
+}
+
+const QualityLimits& QualityGovernor::Limits() const
+{
+    return LEVELS[this->level];
+}
+
+// whether two levels leave the player's settings the same
+bool QualityGovernor::same(unsigned int a, unsigned int b) const
+{
+    const QualityLimits& first = LEVELS[a];
+    const QualityLimits& second = LEVELS[b];
+    return std::min(first.RenderScale, this->settings.RenderScale) == std::min(second.RenderScale, this->settings.RenderScale) &&
+           std::min(first.Samples, this->settings.Samples) == std::min(second.Samples, this->settings.Samples) &&
+           first.BloomDivisor * this->settings.BloomDivisor == second.BloomDivisor * this->settings.BloomDivisor &&
+           first.ParticleShare == second.ParticleShare;
+}
+
+void QualityGovernor::step(unsigned int level, float cpuTime, float gpuTime)
+{
+    std::cout << "QUALITY: level " << this->level << " -> " << level << " (" << LEVELS[level].Name << "), cpu "
+              << cpuTime << " ms, gpu " << gpuTime << " ms over " << WINDOW << " frames, budget " << this->budget << " ms" << std::endl;
+    this->level = level;
+    this->settle = SETTLE_FRAMES;
+}
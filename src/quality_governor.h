@@ -0,0 +1,65 @@
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+
+#include <vector>
+
+// Upper limits on the quality settings at one governor level, the player's own
+// settings apply below them.
+struct QualityLimits {
+    // what this level gave up, for the log
+    const char*  Name;
+    float        RenderScale;
+    unsigned int Samples;
+    // the bloom targets are 1/BloomDivisor and 1/(2*BloomDivisor) of the render resolution
+    unsigned int BloomDivisor;
+    // share of the particle pool the emitters may use
+    float        ParticleShare;
+};
+
+// Steps quality down while frames take longer than the budget and back up once they
+// stay well under it. A decision looks at the average CPU and GPU time of a full
+// window measured at the current level, and going up takes several calm windows in
+// a row, so it settles instead of flipping between two levels. A level that had to
+// be left right after stepping up to it takes twice as many calm windows the next
+// time. Levels that would not lower any of the player's settings are skipped. Every
+// step is logged.
+class QualityGovernor
+{
+public:
+    // frames averaged for one decision
+    static const unsigned int WINDOW = 60;
+
+    QualityGovernor();
+
+    // milliseconds a frame may take, 0 turns the governor off and lifts every limit
+    void SetBudget(float budget);
+    float Budget() const { return this->budget; }
+    // the player's own settings, once a frame before Update
+    void SetSettings(float renderScale, unsigned int samples, bool bloom);
+    // once a rendered frame, with its CPU time and the newest GPU frame time (0 when
+    // there is none); true when the level changed
+    bool Update(float cpuTime, float gpuTime);
+    // 0 limits nothing, higher gives up more
+    unsigned int Level() const { return this->level; }
+    const QualityLimits& Limits() const;
+
+private:
+    float budget;
+    unsigned int level;
+    float cpuTotal, gpuTotal;
+    unsigned int count;
+    // frames after a change that still show the previous level, GPU times arrive late
+    unsigned int settle;
+    // windows in a row under the step up threshold
+    unsigned int calm;
+    // calm windows needed to step up to each level
+    std::vector<unsigned int> calmNeeded;
+    // windows since the last step up, the level it reached failed if it is left within CALM_WINDOWS
+    unsigned int sinceUp;
+    QualityLimits settings;
+
+    bool same(unsigned int a, unsigned int b) const;
+    void step(unsigned int level, float cpuTime, float gpuTime);
+};
+
+#endif
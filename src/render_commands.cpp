@@ -0,0 +1,28 @@
+#include "render_commands.h"
+
+RenderCommandList::RenderCommandList()
+    : Recorded(false), ParticleLayer(0), ParticleTime(0.0f), Time(0.0f), SimulateTime(0.0f), Post(), RenderScale(1.0f), State(0), Lives(0), Level(0), Static(false), Overlay(false)
+{
+}
+
+void RenderCommandList::Clear()
+{
+    this->Recorded = false;
+    this->Sprites.clear();
+    this->ParticleLayer = 0;
+    this->Emits.clear();
+    this->ParticleTime = 0.0f;
+    this->Static = false;
+}
+
+void RenderCommandList::DrawSprite(const TextureHandle& texture, glm::vec2 position, glm::vec2 size, float rotate, glm::vec3 color)
+{
+    SpriteCommand command = { texture.Index(), position, size, rotate, color };
+    this->Sprites.push_back(command);
+}
+
+void RenderCommandList::Emit(const char* emitter, glm::vec2 position, glm::vec2 velocity, glm::vec3 tint)
+{
+    EmitCommand command = { emitter, position, velocity, tint };
+    this->Emits.push_back(command);
+}
@@ -0,0 +1,62 @@
+#ifndef RENDER_COMMANDS_H
+#define RENDER_COMMANDS_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "texture.h"
+#include "post_processor.h"
+#include "resource_manager.h"
+
+struct SpriteCommand {
+    // TextureHandle index, resolved on the GL thread
+    unsigned int Texture;
+    glm::vec2    Position, Size;
+    float        Rotate;
+    glm::vec3    Color;
+};
+
+struct EmitCommand {
+    // emitter name, a string literal
+    const char* Emitter;
+    glm::vec2   Position, Velocity;
+    glm::vec3   Tint;
+};
+
+// One simulated frame as plain data. The simulation thread records it without
+// touching GL, the GL thread submits it while the next one is being recorded.
+class RenderCommandList
+{
+public:
+    // false until the simulation has filled it once
+    bool Recorded;
+    std::vector<SpriteCommand> Sprites;
+    // sprites before this index are drawn under the particles, the rest above
+    unsigned int ParticleLayer;
+    std::vector<EmitCommand> Emits;
+    // how far the particles advance, 0 while paused
+    float ParticleTime;
+    // simulated seconds since start, the time effects animate with
+    float Time;
+    // CPU milliseconds Simulate took to record it
+    float SimulateTime;
+    PostSettings Post;
+    // render resolution relative to the output, 0.5 to 2.0
+    float RenderScale;
+    // game state the HUD is drawn from
+    int State;
+    unsigned int Lives, Level;
+    // nothing moves until the next input (menu, win screen, pause), drawn once and then cached
+    bool Static;
+    // pass timings and counters drawn over the frame
+    bool Overlay;
+
+    RenderCommandList();
+    // keeps the capacity, so a steady frame records without allocating
+    void Clear();
+    void DrawSprite(const TextureHandle& texture, glm::vec2 position, glm::vec2 size = glm::vec2(10.0f, 10.0f), float rotate = 0.0f, glm::vec3 color = glm::vec3(1.0f));
+    void Emit(const char* emitter, glm::vec2 position, glm::vec2 velocity = glm::vec2(0.0f), glm::vec3 tint = glm::vec3(1.0f));
+};
+
+#endif
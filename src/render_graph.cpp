@@ -0,0 +1,411 @@
+#include "render_graph.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// pooled targets nobody asked for in this many frames are freed
+const unsigned int POOL_IDLE_FRAMES = 120;
+
+RenderGraph::RenderGraph(unsigned int width, unsigned int height)
+    : PassesRun(0), PassesCulled(0), TargetsAllocated(0), Profile(true), FrameTime(0.0f), width(width), height(height),
+      outputX(0), outputY(0), outputWidth(width), outputHeight(height), backbuffer(0), frame(0)
+{
+    this->Reset();
+}
+
+RenderGraph::~RenderGraph()
+{
+    for (Physical& physical : this->pool)
+        this->release(physical);
+    for (std::vector<PendingQuery>& slot : this->pending)
+        for (const PendingQuery& query : slot)
+            this->freeQueries.push_back(query.Query);
+    if (!this->freeQueries.empty())
+        glDeleteQueries(static_cast<GLsizei>(this->freeQueries.size()), this->freeQueries.data());
+    GLState::Invalidate();
+}
+
+void RenderGraph::SetSize(unsigned int width, unsigned int height)
+{
+    this->width = width;
+    this->height = height;
+}
+
+void RenderGraph::SetOutput(unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+{
+    this->outputX = x;
+    this->outputY = y;
+    this->outputWidth = width;
+    this->outputHeight = height;
+}
+
+void RenderGraph::SetBackbuffer(unsigned int fbo)
+{
+    this->backbuffer = fbo;
+}
+
+void RenderGraph::Reset()
+{
+    this->resources.clear();
+    this->passes.clear();
+    RenderTargetDesc backbuffer = { this->outputWidth, this->outputHeight, GL_RGBA8, 0 };
+    Resource resource = { "backbuffer", backbuffer, -1, -1, -1 };
+    this->resources.push_back(resource);
+}
+
+unsigned int RenderGraph::CreateTarget(const char* name, RenderTargetDesc desc)
+{
+    Resource resource = { name, desc, -1, -1, -1 };
+    this->resources.push_back(resource);
+    return static_cast<unsigned int>(this->resources.size() - 1);
+}
+
+void RenderGraph::AddPass(const char* name, std::initializer_list<unsigned int> reads, unsigned int write, std::function<void()> execute)
+{
+    Pass pass;
+    pass.Name = name;
+    pass.ReadCount = 0;
+    for (unsigned int read : reads)
+    {
+        if (pass.ReadCount == MAX_PASS_READS)
+        {
+            std::cout << "ERROR::RENDERGRAPH: Too many inputs for pass " << name << std::endl;
+            break;
+        }
+        pass.Reads[pass.ReadCount++] = read;
+    }
+    pass.Write = write;
+    pass.Execute = std::move(execute);
+    pass.Culled = false;
+    this->passes.push_back(std::move(pass));
+}
+
+void RenderGraph::Execute()
+{
+    this->frame++;
+    this->cull();
+    this->schedule();
+    this->allocate();
+
+    // the slot this frame's queries go in still holds the ones from TIMING_LATENCY frames ago
+    unsigned int slot = this->frame % TIMING_LATENCY;
+    this->collect(slot);
+    this->issued[slot] = std::chrono::steady_clock::now();
+    for (unsigned int index : this->order)
+    {
+        Pass& pass = this->passes[index];
+        const Resource& target = this->resources[pass.Write];
+        if (pass.Write == BACKBUFFER)
+        {
+            GLState::BindFramebuffer(GL_FRAMEBUFFER, this->backbuffer);
+            glViewport(this->outputX, this->outputY, this->outputWidth, this->outputHeight);
+        }
+        else
+        {
+            GLState::BindFramebuffer(GL_FRAMEBUFFER, this->pool[target.Physical].FBO);
+            glViewport(0, 0, target.Desc.Width, target.Desc.Height);
+        }
+        if (!this->Profile)
+        {
+            pass.Execute();
+            continue;
+        }
+        if (this->freeQueries.empty())
+        {
+            unsigned int query;
+            glGenQueries(1, &query);
+            this->freeQueries.push_back(query);
+        }
+        PendingQuery query = { pass.Name, this->freeQueries.back() };
+        this->freeQueries.pop_back();
+        glBeginQuery(GL_TIME_ELAPSED, query.Query);
+        pass.Execute();
+        glEndQuery(GL_TIME_ELAPSED);
+        this->pending[slot].push_back(query);
+    }
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, this->backbuffer);
+    glViewport(this->outputX, this->outputY, this->outputWidth, this->outputHeight);
+    this->PassesRun = static_cast<unsigned int>(this->order.size());
+    this->PassesCulled = static_cast<unsigned int>(this->passes.size() - this->order.size());
+
+    for (unsigned int i = 0; i < this->pool.size(); )
+    {
+        if (this->pool[i].LastFrame + POOL_IDLE_FRAMES < this->frame)
+        {
+            this->release(this->pool[i]);
+            this->pool.erase(this->pool.begin() + i);
+            GLState::Invalidate();
+        }
+        else
+            ++i;
+    }
+    this->TargetsAllocated = static_cast<unsigned int>(this->pool.size());
+}
+
+std::vector<PassTiming> RenderGraph::Timings() const
+{
+    std::vector<PassTiming> timings;
+    std::vector<float> sorted;
+    for (const PassSamples& pass : this->samples)
+    {
+        sorted = pass.Samples;
+        std::sort(sorted.begin(), sorted.end());
+        float total = 0.0f;
+        for (float sample : sorted)
+            total += sample;
+        unsigned int count = static_cast<unsigned int>(sorted.size());
+        unsigned int last = (pass.Next + count - 1) % count;
+        PassTiming timing = { pass.Name, sorted.front(), total / count, sorted[(count * 99 + 99) / 100 - 1], pass.Samples[last], count };
+        timings.push_back(timing);
+    }
+    return timings;
+}
+
+void RenderGraph::collect(unsigned int slot)
+{
+    // a result that is still not there is dropped rather than waited for
+    double bound = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->issued[slot]).count();
+    float frameTime = 0.0f;
+    bool complete = !this->pending[slot].empty();
+    for (const PendingQuery& query : this->pending[slot])
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(query.Query, GL_QUERY_RESULT_AVAILABLE, &available);
+        this->freeQueries.push_back(query.Query);
+        complete = complete && available;
+        if (!available)
+            continue;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query.Query, GL_QUERY_RESULT, &elapsed);
+        float milliseconds = static_cast<float>(elapsed / 1000000.0);
+        // longer than the time since it was issued: a broken result (llvmpipe's first draw of a context)
+        if (milliseconds > bound)
+        {
+            complete = false;
+            continue;
+        }
+        frameTime += milliseconds;
+
+        PassSamples* pass = nullptr;
+        for (PassSamples& candidate : this->samples)
+            if (std::strcmp(candidate.Name, query.Pass) == 0)
+                pass = &candidate;
+        if (!pass)
+        {
+            PassSamples samples = { query.Pass, std::vector<float>(), 0 };
+            this->samples.push_back(samples);
+            pass = &this->samples.back();
+        }
+        if (pass->Samples.size() < TIMING_WINDOW)
+            pass->Samples.push_back(milliseconds);
+        else
+            pass->Samples[pass->Next] = milliseconds;
+        pass->Next = (pass->Next + 1) % TIMING_WINDOW;
+    }
+    this->pending[slot].clear();
+    if (complete)
+        this->FrameTime = frameTime;
+}
+
+unsigned int RenderGraph::Texture(unsigned int target) const
+{
+    int physical = this->resources[target].Physical;
+    return physical < 0 ? 0 : this->pool[physical].Texture;
+}
+
+unsigned int RenderGraph::Framebuffer(unsigned int target) const
+{
+    if (target == BACKBUFFER)
+        return this->backbuffer;
+    int physical = this->resources[target].Physical;
+    return physical < 0 ? 0 : this->pool[physical].FBO;
+}
+
+const RenderTargetDesc& RenderGraph::Desc(unsigned int target) const
+{
+    return this->resources[target].Desc;
+}
+
+void RenderGraph::BindTexture(unsigned int target, unsigned int unit) const
+{
+    GLState::BindTexture(unit, this->Texture(target));
+}
+
+void RenderGraph::Blit(unsigned int source, unsigned int target, GLenum filter) const
+{
+    const RenderTargetDesc& from = this->resources[source].Desc;
+    const RenderTargetDesc& to = this->resources[target].Desc;
+    unsigned int x = target == BACKBUFFER ? this->outputX : 0;
+    unsigned int y = target == BACKBUFFER ? this->outputY : 0;
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, this->Framebuffer(source));
+    glBlitFramebuffer(0, 0, from.Width, from.Height, x, y, x + to.Width, y + to.Height, GL_COLOR_BUFFER_BIT, filter);
+}
+
+void RenderGraph::cull()
+{
+    // a pass survives if it draws to the back buffer or feeds one that survives
+    std::vector<bool> needed(this->resources.size(), false);
+    needed[BACKBUFFER] = true;
+    for (Pass& pass : this->passes)
+        pass.Culled = true;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (Pass& pass : this->passes)
+        {
+            if (!pass.Culled || !needed[pass.Write])
+                continue;
+            pass.Culled = false;
+            changed = true;
+            for (unsigned int i = 0; i < pass.ReadCount; ++i)
+                needed[pass.Reads[i]] = true;
+        }
+    }
+}
+
+void RenderGraph::schedule()
+{
+    // a pass reads what the last pass declared before it wrote, or, if nothing before it
+    // writes that target, whatever writes it later; a pass that overwrites a target also
+    // waits for the earlier passes still reading the old contents. Among ready passes
+    // the one declared first goes first.
+    unsigned int count = static_cast<unsigned int>(this->passes.size());
+    std::vector<std::vector<unsigned int>> dependents(count);
+    std::vector<unsigned int> waiting(count, 0);
+    std::vector<int> lastWriter(this->resources.size(), -1);
+    // writer of each resource as seen from each pass's position in declaration order
+    std::vector<std::vector<int>> writerBefore(count);
+    for (unsigned int p = 0; p < count; ++p)
+    {
+        writerBefore[p] = lastWriter;
+        if (!this->passes[p].Culled)
+            lastWriter[this->passes[p].Write] = p;
+    }
+
+    for (unsigned int p = 0; p < count; ++p)
+    {
+        const Pass& pass = this->passes[p];
+        if (pass.Culled)
+            continue;
+        for (unsigned int q = 0; q < count; ++q)
+        {
+            const Pass& other = this->passes[q];
+            if (q == p || other.Culled)
+                continue;
+            bool dependsOn = false;
+            for (unsigned int i = 0; i < pass.ReadCount; ++i)
+            {
+                int writer = writerBefore[p][pass.Reads[i]];
+                if (writer >= 0 ? writer == static_cast<int>(q) : other.Write == pass.Reads[i])
+                    dependsOn = true;
+            }
+            if (q < p && other.Write == pass.Write)
+                dependsOn = true;
+            for (unsigned int i = 0; i < other.ReadCount && q < p; ++i)
+                if (other.Reads[i] == pass.Write && writerBefore[q][pass.Write] >= 0)
+                    dependsOn = true;
+            if (dependsOn)
+            {
+                dependents[q].push_back(p);
+                waiting[p]++;
+            }
+        }
+    }
+
+    this->order.clear();
+    std::vector<bool> done(count, false);
+    while (true)
+    {
+        unsigned int next = count;
+        for (unsigned int p = 0; p < count && next == count; ++p)
+            if (!this->passes[p].Culled && !done[p] && waiting[p] == 0)
+                next = p;
+        if (next == count)
+            break;
+        done[next] = true;
+        this->order.push_back(next);
+        for (unsigned int dependent : dependents[next])
+            waiting[dependent]--;
+    }
+    for (unsigned int p = 0; p < count; ++p)
+        if (!this->passes[p].Culled && !done[p])
+            std::cout << "ERROR::RENDERGRAPH: Pass " << this->passes[p].Name << " is part of a cycle and was skipped" << std::endl;
+}
+
+void RenderGraph::allocate()
+{
+    for (unsigned int position = 0; position < this->order.size(); ++position)
+    {
+        const Pass& pass = this->passes[this->order[position]];
+        for (unsigned int i = 0; i <= pass.ReadCount; ++i)
+        {
+            Resource& resource = this->resources[i < pass.ReadCount ? pass.Reads[i] : pass.Write];
+            if (resource.FirstUse < 0)
+                resource.FirstUse = position;
+            resource.LastUse = position;
+        }
+    }
+
+    for (Physical& physical : this->pool)
+        physical.BusyUntil = -1;
+    // resources were created in roughly execution order, but alias strictly by first use
+    for (unsigned int position = 0; position < this->order.size(); ++position)
+        for (unsigned int r = BACKBUFFER + 1; r < this->resources.size(); ++r)
+        {
+            Resource& resource = this->resources[r];
+            if (resource.FirstUse == static_cast<int>(position))
+                resource.Physical = this->acquire(resource.Desc, resource.FirstUse, resource.LastUse);
+        }
+}
+
+int RenderGraph::acquire(const RenderTargetDesc& desc, int firstUse, int lastUse)
+{
+    for (unsigned int i = 0; i < this->pool.size(); ++i)
+    {
+        Physical& physical = this->pool[i];
+        if (physical.BusyUntil < firstUse && physical.Desc == desc)
+        {
+            physical.BusyUntil = lastUse;
+            physical.LastFrame = this->frame;
+            return i;
+        }
+    }
+
+    Physical physical = { desc, 0, 0, 0, lastUse, this->frame };
+    glGenFramebuffers(1, &physical.FBO);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, physical.FBO);
+    if (desc.Samples > 0)
+    {
+        glGenRenderbuffers(1, &physical.Renderbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, physical.Renderbuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.Samples, desc.Format, desc.Width, desc.Height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, physical.Renderbuffer);
+    }
+    else
+    {
+        glGenTextures(1, &physical.Texture);
+        GLState::BindTextureForEdit(0, physical.Texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.Format, desc.Width, desc.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, physical.Texture, 0);
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::RENDERGRAPH: Failed to create a " << desc.Width << "x" << desc.Height << " target" << std::endl;
+    this->pool.push_back(physical);
+    return static_cast<int>(this->pool.size() - 1);
+}
+
+void RenderGraph::release(Physical& physical)
+{
+    glDeleteFramebuffers(1, &physical.FBO);
+    if (physical.Texture)
+        glDeleteTextures(1, &physical.Texture);
+    if (physical.Renderbuffer)
+        glDeleteRenderbuffers(1, &physical.Renderbuffer);
+}
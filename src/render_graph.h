@@ -0,0 +1,141 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Size and format of a transient render target.
+struct RenderTargetDesc {
+    unsigned int Width, Height;
+    // sized internal format, e.g. GL_RGBA8
+    GLenum       Format;
+    // 0 is a texture that later passes can sample, otherwise a multisample renderbuffer
+    unsigned int Samples;
+
+    bool operator==(const RenderTargetDesc& other) const
+    {
+        return Width == other.Width && Height == other.Height && Format == other.Format && Samples == other.Samples;
+    }
+};
+
+// GPU time of one pass in milliseconds, over the last frames it ran in.
+struct PassTiming {
+    const char*  Name;
+    float        Min, Average, P99, Last;
+    unsigned int Samples;
+};
+
+// One frame of rendering, rebuilt every frame: passes declare what they read and
+// write, Execute orders them, drops the ones nothing depends on and backs the
+// transient targets with pooled framebuffers, sharing memory between targets
+// whose lifetimes do not overlap.
+class RenderGraph
+{
+public:
+    static const unsigned int MAX_PASS_READS = 4;
+    static const unsigned int BACKBUFFER = 0;
+    // pass timer results are read this many frames after they were issued, so reading never stalls
+    static const unsigned int TIMING_LATENCY = 4;
+    // frames each pass's statistics cover
+    static const unsigned int TIMING_WINDOW = 240;
+
+    RenderGraph(unsigned int width, unsigned int height);
+    ~RenderGraph();
+
+    // internal render resolution, the size transient targets are usually made at
+    void SetSize(unsigned int width, unsigned int height);
+    unsigned int Width() const { return this->width; }
+    unsigned int Height() const { return this->height; }
+    // the rectangle of the back buffer passes writing BACKBUFFER draw into
+    void SetOutput(unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+    unsigned int OutputWidth() const { return this->outputWidth; }
+    unsigned int OutputHeight() const { return this->outputHeight; }
+    // framebuffer that stands in for the back buffer, 0 is the window's own
+    void SetBackbuffer(unsigned int fbo);
+
+    // starts a new frame, handles from the previous one are invalid afterwards
+    void Reset();
+    // a target that only lives for this frame
+    unsigned int CreateTarget(const char* name, RenderTargetDesc desc);
+    // the pass runs with write bound as the framebuffer and the viewport set to its size
+    void AddPass(const char* name, std::initializer_list<unsigned int> reads, unsigned int write, std::function<void()> execute);
+    void Execute();
+
+    // only valid inside a pass that declared the target
+    unsigned int Texture(unsigned int target) const;
+    unsigned int Framebuffer(unsigned int target) const;
+    const RenderTargetDesc& Desc(unsigned int target) const;
+    void BindTexture(unsigned int target, unsigned int unit) const;
+    // copies all of source into target, which must be the pass's output
+    void Blit(unsigned int source, unsigned int target, GLenum filter) const;
+
+    // passes run and culled, and physical targets in use, by the last Execute
+    unsigned int PassesRun, PassesCulled, TargetsAllocated;
+    // wraps every pass in a GL_TIME_ELAPSED query, so no other elapsed query may be open around Execute
+    bool Profile;
+    // per pass statistics, in the order the passes first ran
+    std::vector<PassTiming> Timings() const;
+    // GPU milliseconds of all passes of the newest frame whose results are in, TIMING_LATENCY frames old
+    float FrameTime;
+
+private:
+    struct Resource {
+        const char*      Name;
+        RenderTargetDesc Desc;
+        int              Physical;
+        // first and last position in the execution order that touch it
+        int              FirstUse, LastUse;
+    };
+    struct Pass {
+        const char*           Name;
+        unsigned int          Reads[MAX_PASS_READS];
+        unsigned int          ReadCount;
+        unsigned int          Write;
+        std::function<void()> Execute;
+        bool                  Culled;
+    };
+    // pooled framebuffer, kept across frames and handed to any target with the same desc
+    struct Physical {
+        RenderTargetDesc Desc;
+        unsigned int     Texture, Renderbuffer, FBO;
+        // execution position after which it can be reused this frame, -1 when free
+        int              BusyUntil;
+        unsigned int     LastFrame;
+    };
+
+    unsigned int width, height;
+    unsigned int outputX, outputY, outputWidth, outputHeight;
+    unsigned int backbuffer;
+    unsigned int frame;
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<unsigned int> order;
+    std::vector<Physical> pool;
+    struct PendingQuery {
+        const char*  Pass;
+        unsigned int Query;
+    };
+    struct PassSamples {
+        const char*        Name;
+        std::vector<float> Samples;
+        unsigned int       Next;
+    };
+    // queries issued by the last TIMING_LATENCY frames, indexed by frame
+    std::vector<PendingQuery> pending[TIMING_LATENCY];
+    std::chrono::steady_clock::time_point issued[TIMING_LATENCY];
+    std::vector<unsigned int> freeQueries;
+    std::vector<PassSamples> samples;
+
+    void cull();
+    void schedule();
+    void allocate();
+    int  acquire(const RenderTargetDesc& desc, int firstUse, int lastUse);
+    void release(Physical& physical);
+    void collect(unsigned int slot);
+};
+
+#endif
@@ -1,77 +1,625 @@
 #include "resource_manager.h"
+#include "asset_pack.h"
+#include "file_watcher.h"
+#include "gl_state.h"
+#include "thread_pool.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <sys/stat.h>
 #include <iostream>
-#include <sstream>
-#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <learnOpenGL/stb_image.h>
+// only for the DDS header layout written by tools/texture_cook.cpp
+#include <image_DXT.h>
 
-std::map<std::string, Texture2D> ResourceManager::Textures;
-std::map<std::string, Shader> ResourceManager::Shaders;
+// A loaded texture. Handles index the fixed table, so it never moves while the
+// simulation thread copies handles; only the GL thread writes Texture and Loaded.
+struct TextureSlot {
+    Texture2D                 Texture;
+    std::string               Name;
+    // the manager's own while the name is loaded, one per handle and one per pending upload
+    std::atomic<unsigned int> References;
+    bool                      Loaded;
+};
 
-Shader ResourceManager::LoadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, std::string name)
+static TextureSlot textureSlots[MAX_TEXTURES];
+// name hash to slot, written while loading; an unloaded name is no longer in it
+static std::unordered_map<unsigned int, unsigned int> textureIndex;
+// slots whose last reference went, possibly on the simulation thread; the GL thread deletes them
+static std::vector<unsigned int> releasedTextures;
+static std::mutex releasedMutex;
+// by name hash
+static std::unordered_map<unsigned int, Shader> shaders;
+
+// Words of DDS_header::dwReserved1 holding the FNV-1a hash of the source a .dds was
+// cooked from, written by tools/texture_cook.cpp; the tag is "FNVH".
+const unsigned int COOK_HASH_TAG = 0;
+const unsigned int COOK_HASH_LOW = 1;
+const unsigned int COOK_HASH_HIGH = 2;
+
+// A cooked texture: S3TC blocks of every mip level, largest first, read in place
+// from the file's bytes.
+struct DDSImage {
+    unsigned int         Width, Height, Levels;
+    GLenum               Format;
+    AssetView            Source;
+    const unsigned char* Blocks;
+    size_t               Size;
+};
+
+// An image on its way to the GPU: decoded by a worker, then copied into a pixel
+// buffer and uploaded from there, the buffer is freed once its fence has passed.
+struct PendingTexture {
+    unsigned int         Slot;
+    std::string          File;
+    // the .dds read instead of File, empty when there is none
+    std::string          Cooked;
+    DDSImage             Image;
+    unsigned int         Components;
+    // written by the worker, read by the GL thread once Decoded is set
+    unsigned char*       Pixels;
+    int                  Width, Height;
+    std::atomic<bool>    Decoded;
+    unsigned int         PBO;
+    GLsync               Fence;
+};
+
+static bool supportsS3TC()
 {
-    Shaders[name] = loadShaderFromFile(vShaderFile, fShaderFile, gShaderFile);
-    return Shaders[name];
+    static int supported = -1;
+    if (supported < 0)
+    {
+        supported = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i)
+            if (std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), "GL_EXT_texture_compression_s3tc") == 0)
+                supported = 1;
+    }
+    return supported == 1;
 }
 
-Shader ResourceManager::GetShader(std::string name)
+// the cooked .dds next to file, if there is one and the driver can sample it; readDDS checks it is still current
+static std::string cookedFile(const char* file)
 {
-    return Shaders[name];
+    std::string source = file;
+    std::string cooked = source.substr(0, source.find_last_of('.')) + ".dds";
+    struct stat cookedStat;
+    if (!supportsS3TC() || cooked == source)
+        return "";
+    if (AssetPack::Contains(cooked) || stat(cooked.c_str(), &cookedStat) == 0)
+        return cooked;
+    return "";
 }
 
-Texture2D ResourceManager::LoadTexture(const char* file, bool alpha, std::string name)
+// false when file is not a DXT .dds cooked from the current source: TextureCook records
+// the source's hash in the reserved header words, checked here rather than file times,
+// which a checkout sets in no particular order
+static bool readDDS(const std::string& file, const std::string& source, DDSImage& image)
 {
-    Textures[name] = loadTextureFromFile(file, alpha);
-    return Textures[name];
+    AssetView bytes = AssetPack::Read(file);
+    DDS_header header;
+    if (bytes.Size < sizeof(header))
+        return false;
+    std::memcpy(&header, bytes.Data, sizeof(header));
+    if (std::memcmp(&header.dwMagic, "DDS ", 4) != 0)
+        return false;
+    AssetView original = AssetPack::Read(source);
+    if (original)
+    {
+        unsigned long long hash = HashBytes(original.Data, original.Size);
+        if (std::memcmp(&header.dwReserved1[COOK_HASH_TAG], "FNVH", 4) != 0 ||
+            header.dwReserved1[COOK_HASH_LOW] != static_cast<unsigned int>(hash) ||
+            header.dwReserved1[COOK_HASH_HIGH] != static_cast<unsigned int>(hash >> 32))
+        {
+            std::cout << "ERROR::TEXTURE: " << file << " was not cooked from the current " << source << ", decoding the source" << std::endl;
+            return false;
+        }
+    }
+    if (std::memcmp(&header.sPixelFormat.dwFourCC, "DXT1", 4) == 0)
+        image.Format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    else if (std::memcmp(&header.sPixelFormat.dwFourCC, "DXT5", 4) == 0)
+        image.Format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    else
+    {
+        std::cout << "ERROR::TEXTURE: " << file << " is not DXT1 or DXT5" << std::endl;
+        return false;
+    }
+    image.Width = header.dwWidth;
+    image.Height = header.dwHeight;
+    image.Levels = header.dwFlags & DDSD_MIPMAPCOUNT ? std::max(header.dwMipMapCount, 1u) : 1;
+    size_t size = 0;
+    for (unsigned int level = 0; level < image.Levels; ++level)
+        size += Texture2D::CompressedSize(image.Format, std::max(image.Width >> level, 1u), std::max(image.Height >> level, 1u));
+    if (bytes.Size < sizeof(header) + size)
+    {
+        std::cout << "ERROR::TEXTURE: " << file << " is truncated" << std::endl;
+        return false;
+    }
+    image.Source = bytes;
+    image.Blocks = bytes.Data + sizeof(header);
+    image.Size = size;
+    return true;
 }
 
-Texture2D ResourceManager::GetTexture(std::string name)
+// What a named program was built from, to share it on a second load and to
+// rebuild it when one of its files changes.
+struct ShaderSource {
+    std::string Vertex, Fragment, Geometry, Defines;
+    std::vector<std::string> Varyings;
+
+    bool operator==(const ShaderSource& other) const
+    {
+        return Vertex == other.Vertex && Fragment == other.Fragment && Geometry == other.Geometry
+            && Defines == other.Defines && Varyings == other.Varyings;
+    }
+    bool Uses(const std::string& file) const
+    {
+        return Vertex == file || Fragment == file || Geometry == file;
+    }
+};
+
+static std::map<std::string, ShaderSource> shaderSources;
+static FileWatcher* shaderWatcher = nullptr;
+// rebuilt programs still compiling, by name
+static std::map<std::string, Shader> reloadingShaders;
+static ThreadPool* decoders = nullptr;
+static std::vector<std::shared_ptr<PendingTexture>> pendingTextures;
+
+static std::string readShader(const char* file)
 {
-    return Textures[name];
+    AssetView view = AssetPack::Read(file);
+    if (!view)
+        std::cout << "ERROR::SHADER: Failed to read " << file << std::endl;
+    return view.Text();
 }
 
-void ResourceManager::Clear()
+static void insertDefines(std::string& code, const std::string& defines)
 {
-    for (auto iter : Shaders)
-        glDeleteProgram(iter.second.ID);
-    for (auto iter : Textures)
-        glDeleteTextures(1, &iter.second.ID);
+    if (defines.empty())
+        return;
+    size_t line = code.find('\n', code.find("#version"));
+    code.insert(line == std::string::npos ? code.size() : line + 1, defines);
 }
 
-Shader ResourceManager::loadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile)
+Shader ResourceManager::LoadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, std::string name, const std::string& defines)
 {
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::string geometryCode;
-    try {
-        std::ifstream vertexShaderFile(vShaderFile);
-        std::ifstream fragmentShaderFile(fShaderFile);
-        std::stringstream vShaderStream, fShaderStream;
+    // loading the same program again hands out the one already compiling
+    ShaderSource source;
+    source.Vertex = vShaderFile;
+    source.Fragment = fShaderFile;
+    source.Geometry = gShaderFile ? gShaderFile : "";
+    source.Defines = defines;
+    unsigned int hash = HashName(name.c_str());
+    if (shaders.count(hash) && shaderSources[name] == source)
+        return shaders[hash];
+    shaders[hash] = loadShaderFromFile(vShaderFile, fShaderFile, gShaderFile, defines);
+    watchShader(name, source);
+    return shaders[hash];
+}
 
-        vShaderStream << vertexShaderFile.rdbuf();
-        fShaderStream << fragmentShaderFile.rdbuf();
+Shader ResourceManager::LoadFeedbackShader(const char* vShaderFile, const char* const* varyings, int count, std::string name)
+{
+    ShaderSource source;
+    source.Vertex = vShaderFile;
+    source.Varyings.assign(varyings, varyings + count);
+    unsigned int hash = HashName(name.c_str());
+    shaders[hash] = loadFeedbackShaderFromFile(vShaderFile, varyings, count);
+    watchShader(name, source);
+    return shaders[hash];
+}
+
+void ResourceManager::watchShader(const std::string& name, const ShaderSource& source)
+{
+    shaderSources[name] = source;
+    if (!shaderWatcher)
+        return;
+    shaderWatcher->Watch(source.Vertex);
+    if (!source.Fragment.empty())
+        shaderWatcher->Watch(source.Fragment);
+    if (!source.Geometry.empty())
+        shaderWatcher->Watch(source.Geometry);
+}
 
-        vertexShaderFile.close();
-        fragmentShaderFile.close();
+void ResourceManager::WatchShaders()
+{
+    if (shaderWatcher)
+        return;
+    shaderWatcher = new FileWatcher();
+    for (auto& source : shaderSources)
+        watchShader(source.first, source.second);
+}
 
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+unsigned int ResourceManager::ReloadShaders()
+{
+    if (!shaderWatcher)
+        return 0;
+    for (const std::string& file : shaderWatcher->Changed())
+    {
+        for (auto& entry : shaderSources)
+        {
+            const ShaderSource& source = entry.second;
+            if (!source.Uses(file))
+                continue;
+            // saved again before the last rebuild finished: that one is outdated
+            reloadingShaders.erase(entry.first);
+            if (source.Varyings.empty())
+                reloadingShaders[entry.first] = loadShaderFromFile(source.Vertex.c_str(), source.Fragment.c_str(),
+                    source.Geometry.empty() ? nullptr : source.Geometry.c_str(), source.Defines);
+            else
+            {
+                std::vector<const char*> varyings;
+                for (const std::string& varying : source.Varyings)
+                    varyings.push_back(varying.c_str());
+                reloadingShaders[entry.first] = loadFeedbackShaderFromFile(source.Vertex.c_str(), varyings.data(), static_cast<int>(varyings.size()));
+            }
+        }
+    }
 
-        if (gShaderFile != nullptr)
+    // polled, so a frame never waits on the driver's compile threads
+    unsigned int swapped = 0;
+    for (auto iter = reloadingShaders.begin(); iter != reloadingShaders.end(); )
+    {
+        if (!iter->second.Ready())
+        {
+            ++iter;
+            continue;
+        }
+        if (iter->second.Linked())
         {
-            std::ifstream geometryShaderFile(gShaderFile);
-            std::stringstream gShaderStream;
-            gShaderStream << geometryShaderFile.rdbuf();
-            geometryShaderFile.close();
-            geometryCode = gShaderStream.str();
+            shaders[HashName(iter->first.c_str())].Replace(iter->second);
+            swapped++;
+            std::cout << "SHADER: Reloaded " << iter->first << std::endl;
         }
+        else
+            std::cout << "ERROR::SHADER: " << iter->first << " failed to build, the running version stays" << std::endl;
+        iter = reloadingShaders.erase(iter);
     }
-    catch (std::exception e)
+    return swapped;
+}
+
+Shader ResourceManager::GetShader(ResourceId name)
+{
+    std::unordered_map<unsigned int, Shader>::const_iterator shader = shaders.find(name.Hash);
+    return shader != shaders.end() ? shader->second : Shader();
+}
+
+TextureHandle ResourceManager::LoadTexture(const char* file, bool alpha, std::string name)
+{
+    unsigned int index = storeTexture(name, loadTextureFromFile(file, alpha));
+    retainTexture(index);
+    return TextureHandle(index);
+}
+
+TextureHandle ResourceManager::LoadTextureAsync(const char* file, bool alpha, std::string name)
+{
+    if (!decoders)
+        decoders = new ThreadPool();
+    std::shared_ptr<PendingTexture> pending = std::make_shared<PendingTexture>();
+    Texture2D texture;
+    if (alpha)
     {
-        std::cout << "ERROR::SHADER: Failed to read shader files" << std::endl;
+        texture.Internal_Format = GL_RGBA;
+        texture.Image_Format = GL_RGBA;
     }
+    // the header is read now so the stored texture already has its final size
+    int components;
+    if (AssetPack::Contains(file))
+    {
+        AssetView header = AssetPack::Read(file);
+        stbi_info_from_memory(header.Data, static_cast<int>(header.Size), &pending->Width, &pending->Height, &components);
+    }
+    else
+        stbi_info(file, &pending->Width, &pending->Height, &components);
+    texture.Width = pending->Width;
+    texture.Height = pending->Height;
+    // the GL texture itself is created on upload, the slot holds ID 0 until then
+    pending->Slot = storeTexture(name, texture);
+    if (pending->Slot == 0)
+        return TextureHandle();
+    pending->File = file;
+    pending->Cooked = cookedFile(file);
+    pending->Components = alpha ? 4 : 3;
+    pending->Pixels = nullptr;
+    pending->Decoded = false;
+    pending->PBO = 0;
+    pending->Fence = 0;
+    // the slot stays while the upload is in flight, even if every handle is dropped
+    retainTexture(pending->Slot);
+    pendingTextures.push_back(pending);
+    decoders->Submit([pending]() {
+        if (pending->Cooked.empty() || !readDDS(pending->Cooked, pending->File, pending->Image))
+        {
+            int width, height, components;
+            AssetView source = AssetPack::Read(pending->File);
+            if (source)
+                pending->Pixels = stbi_load_from_memory(source.Data, static_cast<int>(source.Size), &width, &height, &components, pending->Components);
+        }
+        pending->Decoded = true;
+    });
+    retainTexture(pending->Slot);
+    return TextureHandle(pending->Slot);
+}
+
+unsigned int ResourceManager::UploadTextures()
+{
+    deleteReleasedTextures();
+    for (size_t i = 0; i < pendingTextures.size(); )
+    {
+        PendingTexture& pending = *pendingTextures[i];
+        if (pending.Fence)
+        {
+            // the copy out of the pixel buffer is done, the buffer can go
+            GLenum status = glClientWaitSync(pending.Fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            {
+                ++i;
+                continue;
+            }
+            glDeleteSync(pending.Fence);
+            glDeleteBuffers(1, &pending.PBO);
+            releaseTexture(pending.Slot);
+            pendingTextures.erase(pendingTextures.begin() + i);
+            continue;
+        }
+        if (!pending.Decoded)
+        {
+            ++i;
+            continue;
+        }
+        if (!pending.Pixels && !pending.Image.Blocks)
+        {
+            std::cout << "ERROR::TEXTURE: Failed to load " << pending.File << std::endl;
+            releaseTexture(pending.Slot);
+            pendingTextures.erase(pendingTextures.begin() + i);
+            continue;
+        }
+
+        Texture2D& texture = textureSlots[pending.Slot].Texture;
+        bool compressed = pending.Image.Blocks != nullptr;
+        const unsigned char* source = compressed ? pending.Image.Blocks : pending.Pixels;
+        size_t size = compressed ? pending.Image.Size : static_cast<size_t>(pending.Width) * pending.Height * pending.Components;
+        glGenBuffers(1, &pending.PBO);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pending.PBO);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped)
+        {
+            std::memcpy(mapped, source, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        else
+        {
+            // upload straight from client memory, with the buffer still bound the pointer would be read as an offset into it
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(1, &pending.PBO);
+            pending.PBO = 0;
+        }
+        // rows of RGB images are not 4 byte aligned; with a buffer bound the data pointer is an offset into it
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (compressed)
+            texture.GenerateCompressed(pending.Image.Width, pending.Image.Height, pending.Image.Format, pending.Image.Levels, mapped ? nullptr : source);
+        else
+            texture.Generate(pending.Width, pending.Height, mapped ? nullptr : pending.Pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        pending.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        stbi_image_free(pending.Pixels);
+        pending.Pixels = nullptr;
+        pending.Image = DDSImage();
+        ++i;
+    }
+    return static_cast<unsigned int>(pendingTextures.size());
+}
+
+void ResourceManager::FinishTextures()
+{
+    if (decoders)
+        decoders->Wait();
+    while (UploadTextures() > 0)
+        glClientWaitSync(pendingTextures.front()->Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+}
+
+TextureHandle ResourceManager::GetTexture(ResourceId name)
+{
+    std::unordered_map<unsigned int, unsigned int>::const_iterator slot = textureIndex.find(name.Hash);
+    if (slot == textureIndex.end())
+        return TextureHandle();
+    retainTexture(slot->second);
+    return TextureHandle(slot->second);
+}
+
+const Texture2D& ResourceManager::Texture(unsigned int index)
+{
+    return textureSlots[index < MAX_TEXTURES ? index : 0].Texture;
+}
+
+unsigned int ResourceManager::storeTexture(const std::string& name, const Texture2D& texture)
+{
+    unsigned int hash = HashName(name.c_str());
+    std::unordered_map<unsigned int, unsigned int>::const_iterator loaded = textureIndex.find(hash);
+    if (loaded != textureIndex.end())
+    {
+        // loaded again under the same name: every handle sees the new texture
+        TextureSlot& slot = textureSlots[loaded->second];
+        if (slot.Name != name)
+        {
+            std::cout << "ERROR::RESOURCE: Texture names " << slot.Name << " and " << name << " hash alike" << std::endl;
+            return 0;
+        }
+        glDeleteTextures(1, &slot.Texture.ID);
+        // the name may come back from glGenTextures while the cache still has it bound
+        GLState::Invalidate();
+        slot.Texture = texture;
+        return loaded->second;
+    }
+    for (unsigned int index = 1; index < MAX_TEXTURES; ++index)
+    {
+        TextureSlot& slot = textureSlots[index];
+        if (slot.Loaded || slot.References > 0)
+            continue;
+        slot.Texture = texture;
+        slot.Name = name;
+        slot.References = 1;
+        slot.Loaded = true;
+        textureIndex[hash] = index;
+        return index;
+    }
+    std::cout << "ERROR::RESOURCE: More than " << MAX_TEXTURES - 1 << " textures, " << name << " is not loaded" << std::endl;
+    return 0;
+}
+
+void ResourceManager::retainTexture(unsigned int index)
+{
+    if (index != 0)
+        textureSlots[index].References++;
+}
+
+void ResourceManager::UnloadTexture(ResourceId name)
+{
+    std::unordered_map<unsigned int, unsigned int>::iterator slot = textureIndex.find(name.Hash);
+    if (slot == textureIndex.end())
+        return;
+    unsigned int index = slot->second;
+    textureIndex.erase(slot);
+    releaseTexture(index);
+    deleteReleasedTextures();
+}
+
+void ResourceManager::releaseTexture(unsigned int index)
+{
+    if (index == 0 || --textureSlots[index].References > 0)
+        return;
+    // any thread can drop the last handle, only the GL thread may delete the texture
+    std::lock_guard<std::mutex> lock(releasedMutex);
+    releasedTextures.push_back(index);
+}
+
+void ResourceManager::deleteReleasedTextures()
+{
+    std::vector<unsigned int> released;
+    {
+        std::lock_guard<std::mutex> lock(releasedMutex);
+        released.swap(releasedTextures);
+    }
+    for (unsigned int index : released)
+    {
+        TextureSlot& slot = textureSlots[index];
+        // deleted by Clear already, or taken again since
+        if (!slot.Loaded || slot.References > 0)
+            continue;
+        glDeleteTextures(1, &slot.Texture.ID);
+        slot.Texture = Texture2D();
+        slot.Name.clear();
+        slot.Loaded = false;
+    }
+    if (!released.empty())
+        GLState::Invalidate();
+}
+
+TextureHandle::TextureHandle(const TextureHandle& other)
+    : index(other.index)
+{
+    ResourceManager::retainTexture(this->index);
+}
+
+TextureHandle& TextureHandle::operator=(const TextureHandle& other)
+{
+    ResourceManager::retainTexture(other.index);
+    ResourceManager::releaseTexture(this->index);
+    this->index = other.index;
+    return *this;
+}
+
+TextureHandle::~TextureHandle()
+{
+    ResourceManager::releaseTexture(this->index);
+}
+
+const Texture2D& TextureHandle::Get() const
+{
+    return ResourceManager::Texture(this->index);
+}
+
+void TextureHandle::Bind(unsigned int unit) const
+{
+    this->Get().Bind(unit);
+}
+
+void ResourceManager::Clear()
+{
+    // joins the decoders, then drops whatever was still on its way
+    delete decoders;
+    decoders = nullptr;
+    for (std::shared_ptr<PendingTexture>& pending : pendingTextures)
+    {
+        stbi_image_free(pending->Pixels);
+        if (pending->Fence)
+            glDeleteSync(pending->Fence);
+        glDeleteBuffers(1, &pending->PBO);
+        releaseTexture(pending->Slot);
+    }
+    pendingTextures.clear();
+    deleteReleasedTextures();
+
+    // the manager holds one reference itself, any other is an owner that outlived its use
+    unsigned int leaks = 0;
+    for (auto& entry : shaderSources)
+    {
+        Shader& shader = shaders[HashName(entry.first.c_str())];
+        if (shader.References() > 1)
+        {
+            std::cout << "ERROR::RESOURCE: Shader " << entry.first << " still has " << shader.References() - 1 << " references" << std::endl;
+            leaks++;
+        }
+        shader.Delete();
+    }
+    for (unsigned int index = 1; index < MAX_TEXTURES; ++index)
+    {
+        TextureSlot& slot = textureSlots[index];
+        if (!slot.Loaded)
+            continue;
+        // an unloaded texture still here has handles left, it has no manager reference
+        unsigned int own = textureIndex.count(HashName(slot.Name.c_str())) ? 1 : 0;
+        if (slot.References > own)
+        {
+            std::cout << "ERROR::RESOURCE: Texture " << slot.Name << " still has " << slot.References - own << " references" << std::endl;
+            leaks++;
+        }
+        // deleted now either way, the context may not outlive this; the slot is free
+        // again once the late handles are dropped
+        glDeleteTextures(1, &slot.Texture.ID);
+        slot.Texture = Texture2D();
+        slot.Name.clear();
+        slot.Loaded = false;
+        slot.References -= own;
+    }
+    if (leaks > 0)
+        std::cout << "ERROR::RESOURCE: " << leaks << " resources leaked at shutdown" << std::endl;
+    textureIndex.clear();
+    shaders.clear();
+    reloadingShaders.clear();
+    shaderSources.clear();
+    delete shaderWatcher;
+    shaderWatcher = nullptr;
+    GLState::Invalidate();
+}
+
+Shader ResourceManager::loadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, const std::string& defines)
+{
+    std::string vertexCode = readShader(vShaderFile);
+    std::string fragmentCode = readShader(fShaderFile);
+    std::string geometryCode = gShaderFile != nullptr ? readShader(gShaderFile) : "";
+    insertDefines(vertexCode, defines);
+    insertDefines(fragmentCode, defines);
+    insertDefines(geometryCode, defines);
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
     const char* gShaderCode = geometryCode.c_str();
@@ -81,6 +629,15 @@ Shader ResourceManager::loadShaderFromFile(const char* vShaderFile, const char*
     return shader;
 }
 
+Shader ResourceManager::loadFeedbackShaderFromFile(const char* vShaderFile, const char* const* varyings, int count)
+{
+    std::string vertexCode = readShader(vShaderFile);
+
+    Shader shader;
+    shader.CompileFeedback(vertexCode.c_str(), varyings, count);
+    return shader;
+}
+
 Texture2D ResourceManager::loadTextureFromFile(const char* file, bool alpha)
 {
     Texture2D texture;
@@ -90,8 +647,17 @@ Texture2D ResourceManager::loadTextureFromFile(const char* file, bool alpha)
         texture.Image_Format = GL_RGBA;
     }
 
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(file, &width, &height, &nrChannels, 0);
+    std::string cooked = cookedFile(file);
+    DDSImage image;
+    if (!cooked.empty() && readDDS(cooked, file, image))
+    {
+        texture.GenerateCompressed(image.Width, image.Height, image.Format, image.Levels, image.Blocks);
+        return texture;
+    }
+
+    int width = 0, height = 0, nrChannels;
+    AssetView source = AssetPack::Read(file);
+    unsigned char* data = source ? stbi_load_from_memory(source.Data, static_cast<int>(source.Size), &width, &height, &nrChannels, 0) : nullptr;
 
     texture.Generate(width, height, data);
 
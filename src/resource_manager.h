@@ -1,30 +1,99 @@
 #ifndef RESOURCE_MANAGER_H
 #define RESOURCE_MANAGER_H
 
-#include <map>
 #include <string>
 #include <glad/glad.h>
 
 #include "texture.h"
 #include "shader.h"
 
+struct ShaderSource;
+
+// textures that can be loaded at once, slot 0 is the empty handle
+const unsigned int MAX_TEXTURES = 256;
+
+// Name of a texture or shader. Declared constexpr, like the UniformId constants, it is
+// hashed at compile time; a string passed straight to GetTexture is hashed per call.
+struct ResourceId
+{
+	unsigned int Hash;
+	constexpr ResourceId(const char* name) : Hash(HashName(name)) { }
+};
+
+// A texture owned by ResourceManager: its index in the texture table. Copies count
+// references, so a GameObject holds four bytes instead of a Texture2D. The manager
+// keeps its own reference until UnloadTexture, the GL texture and its slot go with
+// the last handle after that.
+class TextureHandle
+{
+public:
+	TextureHandle() : index(0) { }
+	TextureHandle(const TextureHandle& other);
+	TextureHandle& operator=(const TextureHandle& other);
+	~TextureHandle();
+
+	unsigned int Index() const { return this->index; }
+	explicit operator bool() const { return this->index != 0; }
+	// GL thread: an empty texture (ID 0) for the empty handle or one not uploaded yet
+	const Texture2D& Get() const;
+	void Bind(unsigned int unit = 0) const;
+
+private:
+	friend class ResourceManager;
+	// adopts a reference taken by the manager
+	explicit TextureHandle(unsigned int index) : index(index) { }
+	unsigned int index;
+};
+
 class ResourceManager
 {
 public:
-	static std::map<std::string, Shader> Shaders;
-	static std::map<std::string, Texture2D> Textures;
 
-	static Shader LoadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, std::string name);
-	static Shader GetShader(std::string name);
+	// defines are inserted after the #version line of every stage, for shader permutations
+	static Shader LoadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, std::string name, const std::string& defines = "");
+	static Shader LoadFeedbackShader(const char* vShaderFile, const char* const* varyings, int count, std::string name);
+	// a Shader is itself a handle: copies share one program, deleted with the last of them
+	static Shader GetShader(ResourceId name);
+	// watches the files of every shader, loaded so far and later; edits to a pack are not seen
+	static void WatchShaders();
+	// GL thread, once a frame: rebuilds the programs whose files changed and swaps each one in
+	// once it has linked, returns how many were swapped; a program that fails to build is
+	// logged and the old one keeps running
+	static unsigned int ReloadShaders();
 
-	static Texture2D LoadTexture(const char* file, bool alpha, std::string name);
-	static Texture2D GetTexture(std::string name);
+	static TextureHandle LoadTexture(const char* file, bool alpha, std::string name);
+	// decodes on a worker thread; the handle can be used at once, it samples black until UploadTextures has uploaded it
+	static TextureHandle LoadTextureAsync(const char* file, bool alpha, std::string name);
+	// GL thread, once a frame: deletes the textures released since the last call and streams
+	// decoded images through pixel buffers, returns how many textures are still loading
+	static unsigned int UploadTextures();
+	// GL thread: blocks until every texture loaded so far is uploaded
+	static void FinishTextures();
+	// the empty handle for a name that was never loaded
+	static TextureHandle GetTexture(ResourceId name);
+	// GL thread: what a handle index (as in a SpriteCommand) refers to
+	static const Texture2D& Texture(unsigned int index);
+	// GL thread: GetTexture no longer finds the name; the texture is deleted once no
+	// handle is left, at the latest by the next UploadTextures after that
+	static void UnloadTexture(ResourceId name);
 
+	// deletes every texture and program; owners should have dropped their handles
+	// first, whatever still holds one is reported as a leak
 	static void Clear();
 private:
+	friend class TextureHandle;
 	ResourceManager(){}
-	static Shader loadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile = nullptr);
+	static Shader loadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile = nullptr, const std::string& defines = "");
+	static Shader loadFeedbackShaderFromFile(const char* vShaderFile, const char* const* varyings, int count);
+	static void watchShader(const std::string& name, const ShaderSource& source);
 	static Texture2D loadTextureFromFile(const char* file, bool alpha);
+	// a slot for name holding texture, with the manager's reference; 0 when the table is full
+	static unsigned int storeTexture(const std::string& name, const Texture2D& texture);
+	static void retainTexture(unsigned int index);
+	// any thread; the last release queues the slot for deleteReleasedTextures
+	static void releaseTexture(unsigned int index);
+	// GL thread: deletes the textures whose last reference went
+	static void deleteReleasedTextures();
 };
 
 #endif
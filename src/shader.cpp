@@ -1,108 +1,444 @@
 #include "shader.h"
+#include "gl_state.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// ARB_get_program_binary (core in 4.1) and KHR_parallel_shader_compile, loaded by hand
+#define GL_COMPLETION_STATUS_KHR           0x91B1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH           0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+static PFNGLGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+static PFNGLPROGRAMBINARYPROC programBinary = nullptr;
+static PFNGLPROGRAMPARAMETERIPROC programParameteri = nullptr;
+// hash of the vendor, renderer and version strings, a driver update invalidates every binary
+static unsigned long long driverKey = 0;
+static bool cacheBinaries = false;
+static bool parallelCompile = false;
+
+unsigned int Shader::frameBuffer = 0;
+
+unsigned long long HashBytes(const void* data, size_t size, unsigned long long hash)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+static bool hasExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+        if (std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), name) == 0)
+            return true;
+    return false;
+}
+
+static const char* stageName(GLenum type)
+{
+    return type == GL_VERTEX_SHADER ? "VERTEX" : type == GL_FRAGMENT_SHADER ? "FRAGMENT" : "GEOMETRY";
+}
+
+static std::string cacheFile(unsigned long long key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.bin", key);
+    return PROGRAM_CACHE_DIRECTORY + std::string(name);
+}
+
+// a cached binary is the format enum followed by the driver's blob
+static bool loadBinary(unsigned int program, unsigned long long key)
+{
+    std::ifstream file(cacheFile(key), std::ios::binary);
+    if (!file)
+        return false;
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    GLenum format;
+    if (bytes.size() <= sizeof(format))
+        return false;
+    std::memcpy(&format, bytes.data(), sizeof(format));
+    programBinary(program, format, bytes.data() + sizeof(format), static_cast<GLsizei>(bytes.size() - sizeof(format)));
+    // a binary the driver no longer accepts just leaves the program unlinked
+    int linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked != 0;
+}
+
+static void storeBinary(unsigned int program, unsigned long long key)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    getProgramBinary(program, length, nullptr, &format, binary.data());
+    std::ofstream file(cacheFile(key), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    file.write(binary.data(), length);
+}
+
+// copies every active uniform value of one linked program into another with the same interface
+static void copyUniforms(unsigned int from, unsigned int to)
+{
+    GLState::UseProgram(to);
+    int count = 0;
+    glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+    char name[256];
+    for (int i = 0; i < count; ++i)
+    {
+        int length, size;
+        unsigned int type;
+        glGetActiveUniform(from, i, sizeof(name), &length, &size, &type, name);
+        std::string base = name;
+        if (length > 3 && base.compare(length - 3, 3, "[0]") == 0)
+            base.erase(length - 3);
+        for (int element = 0; element < size; ++element)
+        {
+            std::string elementName = size > 1 ? base + "[" + std::to_string(element) + "]" : std::string(name);
+            int source = glGetUniformLocation(from, elementName.c_str());
+            int target = glGetUniformLocation(to, elementName.c_str());
+            if (source < 0 || target < 0)
+                continue;
+            float f[16];
+            int n[4];
+            switch (type)
+            {
+            case GL_FLOAT:      glGetUniformfv(from, source, f); glUniform1fv(target, 1, f); break;
+            case GL_FLOAT_VEC2: glGetUniformfv(from, source, f); glUniform2fv(target, 1, f); break;
+            case GL_FLOAT_VEC3: glGetUniformfv(from, source, f); glUniform3fv(target, 1, f); break;
+            case GL_FLOAT_VEC4: glGetUniformfv(from, source, f); glUniform4fv(target, 1, f); break;
+            case GL_FLOAT_MAT3: glGetUniformfv(from, source, f); glUniformMatrix3fv(target, 1, GL_FALSE, f); break;
+            case GL_FLOAT_MAT4: glGetUniformfv(from, source, f); glUniformMatrix4fv(target, 1, GL_FALSE, f); break;
+            case GL_INT_VEC2:   glGetUniformiv(from, source, n); glUniform2iv(target, 1, n); break;
+            case GL_INT_VEC3:   glGetUniformiv(from, source, n); glUniform3iv(target, 1, n); break;
+            case GL_INT_VEC4:   glGetUniformiv(from, source, n); glUniform4iv(target, 1, n); break;
+            case GL_UNSIGNED_INT: glGetUniformuiv(from, source, reinterpret_cast<unsigned int*>(n)); glUniform1uiv(target, 1, reinterpret_cast<unsigned int*>(n)); break;
+            // int, bool and every sampler type: one integer
+            default:            glGetUniformiv(from, source, n); glUniform1iv(target, 1, n); break;
+            }
+        }
+    }
+}
 
 Shader& Shader::Use()
 {
-    glUseProgram(this->ID);
+    this->Finish();
+    GLState::UseProgram(this->ID());
     return *this;
 }
 
 void Shader::Compile(const char* vertexSource, const char* fragmentSource, const char* geometrySource)
 {
-    unsigned int sVertex, sFragment, gShader;
-    sVertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(sVertex, 1, &vertexSource, NULL);
-    glCompileShader(sVertex);
-    checkCompileErrors(sVertex, "VERTEX");
-    sFragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(sFragment, 1, &fragmentSource, NULL);
-    glCompileShader(sFragment);
-    checkCompileErrors(sFragment, "FRAGMENT");
-    if (geometrySource != nullptr)
+    const char* sources[] = { vertexSource, fragmentSource, geometrySource };
+    const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+    this->submit(sources, types, geometrySource != nullptr ? 3 : 2, nullptr, 0);
+}
+
+void Shader::CompileFeedback(const char* vertexSource, const char* const* varyings, int count)
+{
+    const GLenum type = GL_VERTEX_SHADER;
+    this->submit(&vertexSource, &type, 1, varyings, count);
+}
+
+void Shader::submit(const char* const* sources, const GLenum* types, unsigned int count, const char* const* varyings, int varyingCount)
+{
+    this->state = std::make_shared<ProgramState>();
+    ProgramState& state = *this->state;
+    state.ID = glCreateProgram();
+    state.Pending = true;
+
+    if (cacheBinaries)
+    {
+        unsigned long long key = driverKey;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            key = HashBytes(&types[i], sizeof(types[i]), key);
+            key = HashBytes(sources[i], std::strlen(sources[i]), key);
+        }
+        for (int i = 0; i < varyingCount; ++i)
+            key = HashBytes(varyings[i], std::strlen(varyings[i]) + 1, key);
+        state.Key = key;
+        state.Cached = loadBinary(state.ID, key);
+        if (state.Cached)
+            return;
+        programParameteri(state.ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // no status queries here: each one would wait for the compile it asks about
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        unsigned int stage = glCreateShader(types[i]);
+        glShaderSource(stage, 1, &sources[i], NULL);
+        glCompileShader(stage);
+        glAttachShader(state.ID, stage);
+        state.Stages[state.StageCount] = stage;
+        state.Types[state.StageCount++] = types[i];
+    }
+    if (varyingCount > 0)
+        glTransformFeedbackVaryings(state.ID, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(state.ID);
+}
+
+void Shader::Finish() const
+{
+    if (!this->state || !this->state->Pending)
+        return;
+    ProgramState& state = *this->state;
+    state.Pending = false;
+    int linked = 0;
+    glGetProgramiv(state.ID, GL_LINK_STATUS, &linked);
+    state.Linked = linked != 0;
+    // the compile logs are only read when the link failed, a good program costs one query
+    if (!state.Linked)
     {
-        gShader = glCreateShader(GL_GEOMETRY_SHADER);
-        glShaderSource(gShader, 1, &geometrySource, NULL);
-        glCompileShader(gShader);
-        checkCompileErrors(gShader, "GEOMETRY");
+        for (unsigned int i = 0; i < state.StageCount; ++i)
+            this->checkCompileErrors(state.Stages[i], stageName(state.Types[i]));
+        this->checkCompileErrors(state.ID, "PROGRAM");
     }
-    this->ID = glCreateProgram();
-    glAttachShader(this->ID, sVertex);
-    glAttachShader(this->ID, sFragment);
-    if (geometrySource != nullptr)
-        glAttachShader(this->ID, gShader);
-    glLinkProgram(this->ID);
-    checkCompileErrors(this->ID, "PROGRAM");
-    glDeleteShader(sVertex);
-    glDeleteShader(sFragment);
-    if (geometrySource != nullptr)
-        glDeleteShader(gShader);
+    else if (state.Key != 0 && !state.Cached)
+        storeBinary(state.ID, state.Key);
+    for (unsigned int i = 0; i < state.StageCount; ++i)
+        glDeleteShader(state.Stages[i]);
+    state.StageCount = 0;
+    this->reflect();
+}
+
+bool Shader::Linked() const
+{
+    this->Finish();
+    return this->state && this->state->Linked;
+}
+
+bool Shader::Ready() const
+{
+    if (!this->state || !this->state->Pending || !parallelCompile)
+        return true;
+    int complete = 0;
+    glGetProgramiv(this->state->ID, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete != 0;
+}
+
+Shader::ProgramState::ProgramState()
+    : ID(0), StageCount(0), Key(0), Cached(false), Pending(false), Linked(false)
+{
+}
+
+Shader::ProgramState::~ProgramState()
+{
+    for (unsigned int i = 0; i < this->StageCount; ++i)
+        glDeleteShader(this->Stages[i]);
+    if (this->ID != 0)
+        glDeleteProgram(this->ID);
 }
 
-void Shader::SetFloat(const char* name, float value, bool useShader)
+void Shader::Replace(const Shader& replacement)
+{
+    this->Finish();
+    replacement.Finish();
+    if (!this->state || !replacement.state || this->state == replacement.state)
+        return;
+    if (this->state->Linked)
+        copyUniforms(this->state->ID, replacement.state->ID);
+    // the edited source has its own binary, the old one would never be loaded again
+    if (this->state->Key != 0 && this->state->Key != replacement.state->Key)
+        std::remove(cacheFile(this->state->Key).c_str());
+    glDeleteProgram(this->state->ID);
+    // a new program may get the deleted name, the cached binding must not match it
+    GLState::Invalidate();
+    *this->state = *replacement.state;
+    // the program belongs to this state now, the replacement's must not delete it
+    replacement.state->ID = 0;
+    replacement.state->StageCount = 0;
+}
+
+void Shader::Delete()
+{
+    if (!this->state)
+        return;
+    this->Finish();
+    if (this->state->ID != 0)
+        glDeleteProgram(this->state->ID);
+    *this->state = ProgramState();
+    GLState::Invalidate();
+}
+
+int Shader::Location(UniformId uniform) const
+{
+    this->Finish();
+    if (!this->state)
+        return -1;
+    const std::vector<std::pair<unsigned int, int>>& uniforms = this->state->Uniforms;
+    std::vector<std::pair<unsigned int, int>>::const_iterator it = std::lower_bound(uniforms.begin(), uniforms.end(),
+        std::make_pair(uniform.Hash, INT_MIN));
+    if (it == uniforms.end() || it->first != uniform.Hash)
+        return -1;
+    return it->second;
+}
+
+void Shader::SetFloat(UniformId uniform, float value, bool useShader)
 {
     if (useShader)
         this->Use();
-    glUniform1f(glGetUniformLocation(this->ID, name), value);
+    glUniform1f(this->Location(uniform), value);
 }
 
-void Shader::SetInteger(const char* name, int value, bool useShader)
+void Shader::SetInteger(UniformId uniform, int value, bool useShader)
 {
     if (useShader)
         this->Use();
-    glUniform1i(glGetUniformLocation(this->ID, name), value);
+    glUniform1i(this->Location(uniform), value);
 }
 
-void Shader::SetVector2f(const char* name, float x, float y, bool useShader)
+void Shader::SetVector2f(UniformId uniform, float x, float y, bool useShader)
 {
     if (useShader)
         this->Use();
-    glUniform2f(glGetUniformLocation(this->ID, name), x, y);
+    glUniform2f(this->Location(uniform), x, y);
 }
 
-void Shader::SetVector2f(const char* name, const glm::vec2& value, bool useShader)
+void Shader::SetVector2f(UniformId uniform, const glm::vec2& value, bool useShader)
 {
     if (useShader)
         this->Use();
-    glUniform2f(glGetUniformLocation(this->ID, name), value.x, value.y);
+    glUniform2f(this->Location(uniform), value.x, value.y);
 }
 
-void Shader::SetVector3f(const char* name, float x, float y, float z, bool useShader)
+void Shader::SetVector3f(UniformId uniform, float x, float y, float z, bool useShader)
 {
     if (useShader)
         this->Use();
-    glUniform3f(glGetUniformLocation(this->ID, name), x, y, z);
+    glUniform3f(this->Location(uniform), x, y, z);
 }
 
-void Shader::SetVector3f(const char* name, const glm::vec3& value, bool useShader)
+void Shader::SetVector3f(UniformId uniform, const glm::vec3& value, bool useShader)
 {
     if (useShader)
         this->Use();
-    glUniform3f(glGetUniformLocation(this->ID, name), value.x, value.y, value.z);
+    glUniform3f(this->Location(uniform), value.x, value.y, value.z);
 }
 
-void Shader::SetVector4f(const char* name, float x, float y, float z, float w, bool useShader)
+void Shader::SetVector4f(UniformId uniform, float x, float y, float z, float w, bool useShader)
 {
     if (useShader)
         this->Use();
-    glUniform4f(glGetUniformLocation(this->ID, name), x, y, z, w);
+    glUniform4f(this->Location(uniform), x, y, z, w);
 }
 
-void Shader::SetVector4f(const char* name, const glm::vec4& value, bool useShader)
+void Shader::SetVector4f(UniformId uniform, const glm::vec4& value, bool useShader)
 {
     if (useShader)
         this->Use();
-    glUniform4f(glGetUniformLocation(this->ID, name), value.x, value.y, value.z, value.w);
+    glUniform4f(this->Location(uniform), value.x, value.y, value.z, value.w);
 }
 
-void Shader::SetMatrix4(const char* name, const glm::mat4& matrix, bool useShader)
+void Shader::SetMatrix4(UniformId uniform, const glm::mat4& matrix, bool useShader)
 {
     if (useShader)
         this->Use();
-    glUniformMatrix4fv(glGetUniformLocation(this->ID, name), 1, false, glm::value_ptr(matrix));
+    glUniformMatrix4fv(this->Location(uniform), 1, false, glm::value_ptr(matrix));
+}
+
+void Shader::SetFrameUniforms(const FrameUniforms& frame)
+{
+    if (frameBuffer == 0)
+    {
+        glGenBuffers(1, &frameBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, frameBuffer);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Shader::LoadExtensions(GLADloadproc load)
+{
+    bool binaries = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1) || hasExtension("GL_ARB_get_program_binary");
+    GLint formats = 0;
+    if (binaries)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    getProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+    programBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+    programParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+    cacheBinaries = binaries && formats > 0 && getProgramBinary && programBinary && programParameteri;
+    if (cacheBinaries)
+    {
+        std::string driver = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "\n"
+            + reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "\n"
+            + reinterpret_cast<const char*>(glGetString(GL_VERSION));
+        driverKey = HashBytes(driver.data(), driver.size());
+#ifdef _WIN32
+        _mkdir(PROGRAM_CACHE_DIRECTORY);
+#else
+        mkdir(PROGRAM_CACHE_DIRECTORY, 0755);
+#endif
+    }
+
+    // lets the driver compile on its own threads, glLinkProgram then returns at once
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxCompilerThreads = nullptr;
+    if (hasExtension("GL_KHR_parallel_shader_compile"))
+        maxCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+    else if (hasExtension("GL_ARB_parallel_shader_compile"))
+        maxCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+    parallelCompile = maxCompilerThreads != nullptr;
+    if (maxCompilerThreads)
+        maxCompilerThreads(0xFFFFFFFF);
+}
+
+void Shader::reflect() const
+{
+    // every active uniform is resolved once here, setters never ask the driver again
+    unsigned int program = this->state->ID;
+    std::vector<std::pair<unsigned int, int>>* table = &this->state->Uniforms;
+    table->clear();
+    int count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    char name[256];
+    for (int i = 0; i < count; ++i)
+    {
+        int length, size;
+        unsigned int type;
+        glGetActiveUniform(program, i, sizeof(name), &length, &size, &type, name);
+        int location = glGetUniformLocation(program, name);
+        if (location < 0)
+            continue;
+        table->push_back(std::make_pair(HashName(name), location));
+        // arrays are reported as "name[0]", register the bare name as well
+        if (length > 3 && strcmp(name + length - 3, "[0]") == 0)
+        {
+            name[length - 3] = '\0';
+            table->push_back(std::make_pair(HashName(name), location));
+        }
+    }
+    std::sort(table->begin(), table->end());
+
+    unsigned int block = glGetUniformBlockIndex(program, "Frame");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, block, FRAME_UNIFORM_BINDING);
 }
 
-void Shader::checkCompileErrors(unsigned int object, std::string type)
+void Shader::checkCompileErrors(unsigned int object, std::string type) const
 {
     int success;
     char infoLog[1024];
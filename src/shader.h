@@ -1,30 +1,110 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// FNV-1a, constexpr so uniform names used as constants hash at compile time.
+constexpr unsigned int HashName(const char* name, unsigned int hash = 2166136261u)
+{
+	return *name ? HashName(name + 1, (hash ^ static_cast<unsigned char>(*name)) * 16777619u) : hash;
+}
+
+// Handle of a uniform, looked up in the table reflected at link time.
+struct UniformId
+{
+	unsigned int Hash;
+	constexpr UniformId(const char* name) : Hash(HashName(name)) { }
+};
+
+// std140 layout of the Frame uniform block shared by every program.
+struct FrameUniforms
+{
+	glm::mat4 Projection;
+	float     Time;
+	float     Padding[3];
+};
+
+const unsigned int FRAME_UNIFORM_BINDING = 0;
+
+// 64 bit FNV-1a over a byte range, for caches keyed by content.
+unsigned long long HashBytes(const void* data, size_t size, unsigned long long hash = 14695981039346656037ull);
+
+// Directory linked program binaries are kept in, keyed by source and driver.
+const char* const PROGRAM_CACHE_DIRECTORY = "shader_cache";
+
+// Compile only submits the work: the link status is looked at the first time the
+// program is used, so programs submitted back to back compile side by side. A
+// program linked before on the same driver is loaded from its cached binary.
+// Copies of a Shader share one program, Replace swaps it for all of them; the
+// program is deleted with the last copy, or by Delete.
 class Shader
 {
 public:
-	unsigned int ID;
-	Shader(){}
+	Shader() {}
+	unsigned int ID() const { return this->state ? this->state->ID : 0; }
 	Shader& Use();
 	void Compile(const char* vertexSource, const char* fragmentSource, const char* geometrySource = nullptr);
-	void SetFloat(const char* name, float value, bool useShader = false);
-	void SetInteger(const char* name, int value, bool useShader = false);
-	void SetVector2f(const char* name, float x, float y, bool useShader = false);
-	void SetVector2f(const char* name, const glm::vec2& value, bool useShader = false);
-	void SetVector3f(const char* name, float x, float y, float z, bool useShader = false);
-	void SetVector3f(const char* name, const glm::vec3& value, bool useShader = false);
-	void SetVector4f(const char* name, float x, float y, float z, float w, bool useShader = false);
-	void SetVector4f(const char* name, const glm::vec4& value, bool useShader = false);
-	void SetMatrix4(const char* name, const glm::mat4& matrix, bool useShader = false);
+	void CompileFeedback(const char* vertexSource, const char* const* varyings, int count);
+	// blocks until the link is done, reports errors and reflects the uniforms; Use and Location call it
+	void Finish() const;
+	bool Linked() const;
+	// false while the driver is still compiling, Finish would block; always true without parallel compiles
+	bool Ready() const;
+	// every copy of this shader switches to the linked replacement, keeping the uniform
+	// values set so far; the old program is deleted and the replacement must not be used again
+	void Replace(const Shader& replacement);
+	// deletes the program now, for every copy; they are left with program 0
+	void Delete();
+	// copies sharing the program, this one included
+	long References() const { return this->state.use_count(); }
+	int  Location(UniformId uniform) const;
+	void SetFloat(UniformId uniform, float value, bool useShader = false);
+	void SetInteger(UniformId uniform, int value, bool useShader = false);
+	void SetVector2f(UniformId uniform, float x, float y, bool useShader = false);
+	void SetVector2f(UniformId uniform, const glm::vec2& value, bool useShader = false);
+	void SetVector3f(UniformId uniform, float x, float y, float z, bool useShader = false);
+	void SetVector3f(UniformId uniform, const glm::vec3& value, bool useShader = false);
+	void SetVector4f(UniformId uniform, float x, float y, float z, float w, bool useShader = false);
+	void SetVector4f(UniformId uniform, const glm::vec4& value, bool useShader = false);
+	void SetMatrix4(UniformId uniform, const glm::mat4& matrix, bool useShader = false);
+
+	// uploads the Frame block once for all programs
+	static void SetFrameUniforms(const FrameUniforms& frame);
+	// after gladLoadGL with the same loader: program binaries and parallel compiles,
+	// neither is part of 3.3 core; without them every start compiles serially
+	static void LoadExtensions(GLADloadproc load);
 private:
-	void checkCompileErrors(unsigned int object, std::string type);
+	// the program behind every copy of a Shader, with its compile work while in flight
+	struct ProgramState {
+		ProgramState();
+		~ProgramState();
+		unsigned int       ID;
+		// (name hash, location) sorted by hash
+		std::vector<std::pair<unsigned int, int>> Uniforms;
+		unsigned int       Stages[3];
+		GLenum             Types[3];
+		unsigned int       StageCount;
+		// program cache key, 0 when binaries are not cached
+		unsigned long long Key;
+		// loaded from the cache, there is no binary to store
+		bool               Cached;
+		bool               Pending;
+		bool               Linked;
+	};
+	std::shared_ptr<ProgramState> state;
+	static unsigned int frameBuffer;
+
+	void submit(const char* const* sources, const GLenum* types, unsigned int count, const char* const* varyings, int varyingCount);
+	void checkCompileErrors(unsigned int object, std::string type) const;
+	void reflect() const;
 };
 
 #endif
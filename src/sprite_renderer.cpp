@@ -1,4 +1,10 @@
 #include "sprite_renderer.h"
+#include "gl_state.h"
+#include "render_commands.h"
+#include "resource_manager.h"
+
+constexpr UniformId MODEL("model");
+constexpr UniformId SPRITE_COLOR("spriteColor");
 
 SpriteRenderer::SpriteRenderer(Shader& shader)
 {
@@ -9,6 +15,7 @@ SpriteRenderer::SpriteRenderer(Shader& shader)
 SpriteRenderer::~SpriteRenderer()
 {
 	glDeleteVertexArrays(1, &this->quadVAO);
+	GLState::Invalidate();
 }
 
 void SpriteRenderer::DrawSprite(Texture2D& texture, glm::vec2 position, glm::vec2 size, float rotate, glm::vec3 color)
@@ -23,15 +30,38 @@ void SpriteRenderer::DrawSprite(Texture2D& texture, glm::vec2 position, glm::vec
 
 	model = glm::scale(model, glm::vec3(size, 1.0f));
 
-	this->shader.SetMatrix4("model", model);
-	this->shader.SetVector3f("spriteColor", color);
+	this->shader.SetMatrix4(MODEL, model);
+	this->shader.SetVector3f(SPRITE_COLOR, color);
 
-	glActiveTexture(GL_TEXTURE0);
 	texture.Bind();
 
-	glBindVertexArray(this->quadVAO);
+	GLState::BindVertexArray(this->quadVAO);
 	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glBindVertexArray(0);
+}
+
+void SpriteRenderer::Submit(const SpriteCommand* sprites, unsigned int begin, unsigned int end)
+{
+	if (begin >= end)
+		return;
+	this->shader.Use();
+	GLState::BindVertexArray(this->quadVAO);
+	for (unsigned int i = begin; i < end; ++i)
+	{
+		const SpriteCommand& sprite = sprites[i];
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, glm::vec3(sprite.Position, 0.0f));
+
+		model = glm::translate(model, glm::vec3(0.5f * sprite.Size.x, 0.5f * sprite.Size.y, 0.0f));
+		model = glm::rotate(model, glm::radians(sprite.Rotate), glm::vec3(0.0f, 0.0f, 1.0f));
+		model = glm::translate(model, glm::vec3(-0.5f * sprite.Size.x, -0.5f * sprite.Size.y, 0.0f));
+
+		model = glm::scale(model, glm::vec3(sprite.Size, 1.0f));
+
+		this->shader.SetMatrix4(MODEL, model);
+		this->shader.SetVector3f(SPRITE_COLOR, sprite.Color);
+		GLState::BindTexture(0, ResourceManager::Texture(sprite.Texture).ID);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	}
 }
 
 void SpriteRenderer::initRenderData()
@@ -53,9 +83,9 @@ void SpriteRenderer::initRenderData()
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-	glBindVertexArray(this->quadVAO);
+	GLState::BindVertexArray(this->quadVAO);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	GLState::BindVertexArray(0);
 }
\ No newline at end of file
@@ -8,12 +8,16 @@
 #include "texture.h"
 #include "shader.h"
 
+struct SpriteCommand;
+
 class SpriteRenderer
 {
 public:
 	SpriteRenderer(Shader& shader);
 	~SpriteRenderer();
 	void DrawSprite(Texture2D& texture, glm::vec2 position, glm::vec2 size = glm::vec2(10.0f, 10.0f), float rotate = 0.0f, glm::vec3 color = glm::vec3(1.0f));
+	// draws recorded sprites [begin, end) with the program and quad bound once
+	void Submit(const SpriteCommand* sprites, unsigned int begin, unsigned int end);
 	
 private:
 	Shader shader;
@@ -1,117 +1,468 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 #include <glm/gtc/matrix_transform.hpp>
-#include <ft2build.h>
-#include FT_FREETYPE_H
 
 #include "text_renderer.h"
 #include "resource_manager.h"
+#include "gl_state.h"
 
+#include FT_MODULE_H
 
-TextRenderer::TextRenderer(unsigned int width, unsigned int height)
+const unsigned int ATLAS_SIZE = 1024;
+// cells the atlas keeps for cached glyphs next to the 128 pinned ASCII ones
+const unsigned int MIN_CACHE_CELLS = 64;
+const unsigned int GLYPH_PADDING = 1;
+const unsigned int FLOATS_PER_VERTEX = 7;
+const unsigned int FREE_CELL = 0xFFFFFFFF;
+const unsigned int PINNED_CELL = 0xFFFFFFFF;
+const unsigned int SDF_RASTER_SIZE = 32;
+// distance in pixels covered by the field on each side of an edge
+const int SDF_SPREAD = 6;
+
+// Returns '?' for malformed sequences and never reads past the terminator.
+static unsigned int decodeUTF8(const unsigned char*& c)
+{
+    unsigned int codepoint = *c++;
+    int extra = 0;
+    if (codepoint >= 0xF0)
+    {
+        codepoint &= 0x07;
+        extra = 3;
+    }
+    else if (codepoint >= 0xE0)
+    {
+        codepoint &= 0x0F;
+        extra = 2;
+    }
+    else if (codepoint >= 0xC0)
+    {
+        codepoint &= 0x1F;
+        extra = 1;
+    }
+    else if (codepoint >= 0x80)
+        return '?';
+    while (extra-- > 0)
+    {
+        if ((*c & 0xC0) != 0x80)
+            return '?';
+        codepoint = (codepoint << 6) | (*c++ & 0x3F);
+    }
+    return codepoint;
+}
+
+TextObject::TextObject()
+    : TextObject(0.0f, 0.0f)
+{
+}
+
+TextObject::TextObject(float x, float y, float scale, glm::vec3 color)
+    : text(), position(x, y), scale(scale), color(color), prefix(nullptr), suffix(nullptr), value(0),
+      hasValue(false), dirty(true), version(0), generation(0)
+{
+}
+
+void TextObject::SetText(const char* text)
+{
+    if (!this->hasValue && strncmp(this->text, text, sizeof(this->text) - 1) == 0)
+        return;
+    strncpy(this->text, text, sizeof(this->text) - 1);
+    this->hasValue = false;
+    this->dirty = true;
+}
+
+void TextObject::SetValue(const char* prefix, unsigned int value, const char* suffix)
+{
+    if (this->hasValue && this->value == value && this->prefix == prefix && this->suffix == suffix)
+        return;
+    char digits[10];
+    unsigned int count = 0;
+    unsigned int rest = value;
+    do {
+        digits[count++] = '0' + rest % 10;
+        rest /= 10;
+    } while (rest > 0);
+
+    char* end = this->text + sizeof(this->text) - 1;
+    char* out = this->text;
+    for (const char* c = prefix; *c && out < end; ++c)
+        *out++ = *c;
+    while (count > 0 && out < end)
+        *out++ = digits[--count];
+    for (const char* c = suffix; *c && out < end; ++c)
+        *out++ = *c;
+    *out = '\0';
+
+    this->prefix = prefix;
+    this->suffix = suffix;
+    this->value = value;
+    this->hasValue = true;
+    this->dirty = true;
+}
+
+void TextObject::SetPosition(float x, float y)
+{
+    if (this->position == glm::vec2(x, y))
+        return;
+    this->position = glm::vec2(x, y);
+    this->dirty = true;
+}
+
+void TextObject::SetColor(glm::vec3 color)
+{
+    if (this->color == color)
+        return;
+    this->color = color;
+    this->dirty = true;
+}
+
+TextRenderer::TextRenderer()
+    : Characters(), GlyphsPerFrame(8), SDF(false), OutlineColor(0.0f, 0.0f, 0.0f, 1.0f), OutlineWidth(0.0f),
+      GlowColor(1.0f, 1.0f, 1.0f, 0.5f), GlowWidth(0.0f), atlas(0), atlasSize(ATLAS_SIZE), cellSize(0), cellsPerRow(0), frame(1), rasterized(0),
+      ft(nullptr), fontSize(0), rasterSize(0), unitScale(1.0f), baseline(0), bufferSize(0), generation(0), lastHadImmediate(false), vertexCount(0)
 {
     this->TextShader = ResourceManager::LoadShader("shaders/text.vs", "shaders/text.frag", nullptr, "text");
-    this->TextShader.SetMatrix4("projection", glm::ortho(0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f), true);
-    this->TextShader.SetInteger("text", 0);
+    this->TextShader.SetInteger("text", 0, true);
 
     glGenVertexArrays(1, &this->VAO);
     glGenBuffers(1, &this->VBO);
-    glBindVertexArray(this->VAO);
+    GLState::BindVertexArray(this->VAO);
     glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), 0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(4 * sizeof(float)));
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState::BindVertexArray(0);
+}
+
+TextRenderer::~TextRenderer()
+{
+    this->releaseFonts();
+    glDeleteTextures(1, &this->atlas);
+    glDeleteBuffers(1, &this->VBO);
+    glDeleteVertexArrays(1, &this->VAO);
+    GLState::Invalidate();
 }
 
-void TextRenderer::Load(std::string font, unsigned int fontSize)
+void TextRenderer::Load(std::string font, unsigned int fontSize, bool sdf)
 {
-    this->Characters.clear();
-    FT_Library ft;
-    if (FT_Init_FreeType(&ft))
+    this->releaseFonts();
+    if (FT_Init_FreeType(&this->ft))
+    {
         std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+        this->ft = nullptr;
+        return;
+    }
+    this->SDF = sdf;
+    this->fontSize = fontSize;
+    this->rasterSize = sdf ? SDF_RASTER_SIZE : fontSize;
+    this->unitScale = static_cast<float>(fontSize) / this->rasterSize;
+    if (sdf)
+    {
+        int spread = SDF_SPREAD;
+        FT_Property_Set(this->ft, "sdf", "spread", &spread);
+        FT_Property_Set(this->ft, "bsdf", "spread", &spread);
+    }
 
     FT_Face face;
-    if (FT_New_Face(ft, font.c_str(), 0, &face))
+    if (!this->openFace(font, face))
+    {
         std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+        return;
+    }
+    FT_Set_Pixel_Sizes(face, 0, this->rasterSize);
+    this->faces.push_back(face);
 
-    FT_Set_Pixel_Sizes(face, 0, fontSize);
+    // the atlas is a fixed grid of equal cells, so any glyph can replace any other
+    this->cellSize = std::max(static_cast<unsigned int>(face->size->metrics.height >> 6), this->rasterSize) + 2 * GLYPH_PADDING;
+    if (sdf)
+        this->cellSize += 2 * SDF_SPREAD;
+    // large font sizes get a larger atlas, up to what the driver allows
+    int maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    this->atlasSize = ATLAS_SIZE;
+    while ((this->atlasSize / this->cellSize) * (this->atlasSize / this->cellSize) < 128 + MIN_CACHE_CELLS &&
+           this->atlasSize * 2 <= static_cast<unsigned int>(maxSize))
+        this->atlasSize *= 2;
+    this->cellsPerRow = this->atlasSize / this->cellSize;
+    GlyphCell freeCell = { FREE_CELL, 0 };
+    this->cellTable.assign(this->cellsPerRow * this->cellsPerRow, freeCell);
+    this->cache.clear();
+    unsigned int pinnedCount = std::min(static_cast<unsigned int>(this->cellTable.size()), 128u);
+    if (pinnedCount < 128)
+        std::cout << "ERROR::FREETYPE: Font size " << fontSize << " does not fit the glyph atlas, only the first "
+                  << pinnedCount << " ASCII glyphs are drawn" << std::endl;
 
+    if (this->atlas == 0)
+        glGenTextures(1, &this->atlas);
+    std::vector<unsigned char> blank(this->atlasSize * this->atlasSize, 0);
+    GLState::BindTextureForEdit(0, this->atlas);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, this->atlasSize, this->atlasSize, 0, GL_RED, GL_UNSIGNED_BYTE, blank.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    for (GLubyte c = 0; c < 128; c++)
+    for (unsigned int c = 0; c < 128; c++)
     {
-        if (FT_Load_Char(face, c, FT_LOAD_RENDER))
-        {
-            std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+        this->Characters[c] = Character();
+        if (c >= pinnedCount || !this->rasterize(c, c, this->Characters[c]))
             continue;
-        }
-        unsigned int texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        Character character = {
-            texture,
-            glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-            glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-            face->glyph->advance.x
-        };
-        Characters.insert(std::pair<char, Character>(c, character));
+        GlyphCell pinned = { c, PINNED_CELL };
+        this->cellTable[c] = pinned;
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft);
+    this->baseline = this->Characters['H'].Bearing.y;
+    this->generation++;
 }
 
-void TextRenderer::RenderText(std::string text, float x, float y, float scale, glm::vec3 color)
+bool TextRenderer::AddFallbackFont(std::string font)
 {
+    FT_Face face;
+    if (this->ft == nullptr || !this->openFace(font, face))
+    {
+        std::cout << "ERROR::FREETYPE: Failed to load fallback font " << font << std::endl;
+        return false;
+    }
+    FT_Set_Pixel_Sizes(face, 0, this->rasterSize);
+    this->faces.push_back(face);
+    return true;
+}
+
+void TextRenderer::RenderText(const std::string& text, float x, float y, float scale, glm::vec3 color)
+{
+    this->layout(text.c_str(), x, y, scale, color, this->vertices, nullptr);
+}
+
+void TextRenderer::Draw(TextObject& object)
+{
+    bool stale = object.dirty || object.generation != this->generation;
+    // cached glyphs may have been evicted since the last layout
+    for (const std::pair<unsigned int, unsigned int>& cell : object.cells)
+    {
+        if (stale)
+            break;
+        if (this->cellTable[cell.first].Codepoint != cell.second)
+            stale = true;
+        else
+            this->cellTable[cell.first].LastUsed = this->frame;
+    }
+    if (stale)
+    {
+        object.vertices.clear();
+        object.cells.clear();
+        bool complete = this->layout(object.text, object.position.x, object.position.y, object.scale, object.color, object.vertices, &object.cells);
+        // glyphs over this frame's rasterization budget show up on a later frame
+        object.dirty = !complete;
+        object.generation = this->generation;
+        object.version++;
+    }
+    this->submitted.push_back(std::make_pair(&object, object.version));
+}
+
+void TextRenderer::Flush()
+{
+    bool immediate = !this->vertices.empty();
+    // steady state: same retained objects at the same versions, the buffer is still valid
+    bool reuse = !immediate && !this->lastHadImmediate && this->submitted == this->lastSubmitted;
+    if (!reuse)
+    {
+        this->batch.clear();
+        this->batch.insert(this->batch.end(), this->vertices.begin(), this->vertices.end());
+        for (const std::pair<const TextObject*, unsigned int>& entry : this->submitted)
+            this->batch.insert(this->batch.end(), entry.first->vertices.begin(), entry.first->vertices.end());
+        this->vertexCount = this->batch.size() / FLOATS_PER_VERTEX;
+
+        if (!this->batch.empty())
+        {
+            size_t size = this->batch.size() * sizeof(float);
+            glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+            // orphan the previous storage so the upload never waits on last frame's draw
+            if (size > this->bufferSize)
+                this->bufferSize = size * 2;
+            glBufferData(GL_ARRAY_BUFFER, this->bufferSize, NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, size, this->batch.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+    }
+    this->lastHadImmediate = immediate;
+    this->lastSubmitted.swap(this->submitted);
+    this->submitted.clear();
+    this->vertices.clear();
+    this->frame++;
+    this->rasterized = 0;
+    if (this->vertexCount == 0)
+        return;
+
     this->TextShader.Use();
-    this->TextShader.SetVector3f("textColor", color);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(this->VAO);
+    this->TextShader.SetInteger("sdf", this->SDF);
+    if (this->SDF)
+    {
+        // widths are given in pixels of the raster size, the field spans SDF_SPREAD each way
+        this->TextShader.SetFloat("outlineWidth", this->OutlineWidth * 0.5f / SDF_SPREAD);
+        this->TextShader.SetVector4f("outlineColor", this->OutlineColor);
+        this->TextShader.SetFloat("glowWidth", this->GlowWidth * 0.5f / SDF_SPREAD);
+        this->TextShader.SetVector4f("glowColor", this->GlowColor);
+    }
+    GLState::BindTexture(0, this->atlas);
+    GLState::BindVertexArray(this->VAO);
+    glDrawArrays(GL_TRIANGLES, 0, this->vertexCount);
+}
 
-    std::string::const_iterator c;
-    for (c = text.begin(); c != text.end(); c++)
+bool TextRenderer::layout(const char* text, float x, float y, float scale, glm::vec3 color, std::vector<float>& out,
+    std::vector<std::pair<unsigned int, unsigned int>>* cells)
+{
+    bool complete = true;
+    scale *= this->unitScale;
+    const unsigned char* c = reinterpret_cast<const unsigned char*>(text);
+    while (*c)
     {
-        Character ch = Characters[*c];
+        unsigned int codepoint = decodeUTF8(c);
+        const Character* found = this->glyph(codepoint);
+        if (found == nullptr)
+        {
+            complete = false;
+            x += this->rasterSize * scale;
+            continue;
+        }
+        const Character& ch = *found;
+        if (cells != nullptr && ch.Cell >= 128)
+            cells->push_back(std::make_pair(ch.Cell, codepoint));
 
         float xpos = x + ch.Bearing.x * scale;
-        float ypos = y + (this->Characters['H'].Bearing.y - ch.Bearing.y) * scale;
+        float ypos = y + (this->baseline - ch.Bearing.y) * scale;
 
         float w = ch.Size.x * scale;
         float h = ch.Size.y * scale;
-        float vertices[6][4] = {
-            { xpos,     ypos + h,   0.0f, 1.0f },
-            { xpos + w, ypos,       1.0f, 0.0f },
-            { xpos,     ypos,       0.0f, 0.0f },
-
-            { xpos,     ypos + h,   0.0f, 1.0f },
-            { xpos + w, ypos + h,   1.0f, 1.0f },
-            { xpos + w, ypos,       1.0f, 0.0f }
+        float quad[6][FLOATS_PER_VERTEX] = {
+            { xpos,     ypos + h,   ch.UVMin.x, ch.UVMax.y, color.r, color.g, color.b },
+            { xpos + w, ypos,       ch.UVMax.x, ch.UVMin.y, color.r, color.g, color.b },
+            { xpos,     ypos,       ch.UVMin.x, ch.UVMin.y, color.r, color.g, color.b },
+
+            { xpos,     ypos + h,   ch.UVMin.x, ch.UVMax.y, color.r, color.g, color.b },
+            { xpos + w, ypos + h,   ch.UVMax.x, ch.UVMax.y, color.r, color.g, color.b },
+            { xpos + w, ypos,       ch.UVMax.x, ch.UVMin.y, color.r, color.g, color.b }
         };
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-        glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        out.insert(out.end(), &quad[0][0], &quad[0][0] + sizeof(quad) / sizeof(float));
         x += (ch.Advance >> 6) * scale;
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-}
\ No newline at end of file
+    return complete;
+}
+
+const Character* TextRenderer::glyph(unsigned int codepoint)
+{
+    if (codepoint < 128)
+        return &this->Characters[codepoint];
+    std::unordered_map<unsigned int, Character>::iterator it = this->cache.find(codepoint);
+    if (it != this->cache.end())
+    {
+        this->cellTable[it->second.Cell].LastUsed = this->frame;
+        return &it->second;
+    }
+    if (this->faces.empty() || this->rasterized >= this->GlyphsPerFrame)
+        return nullptr;
+
+    // a free cell if there is one, otherwise the least recently drawn glyph not on screen this frame
+    unsigned int best = FREE_CELL;
+    unsigned int oldest = this->frame;
+    for (unsigned int i = 128; i < this->cellTable.size(); ++i)
+    {
+        if (this->cellTable[i].Codepoint == FREE_CELL)
+        {
+            best = i;
+            break;
+        }
+        if (this->cellTable[i].LastUsed < oldest)
+        {
+            oldest = this->cellTable[i].LastUsed;
+            best = i;
+        }
+    }
+    if (best == FREE_CELL)
+        return nullptr;
+
+    this->rasterized++;
+    Character character;
+    // codepoints no font covers are remembered as '?' so they cost nothing next time
+    if (!this->rasterize(codepoint, best, character))
+        return &(this->cache[codepoint] = this->Characters['?']);
+    if (this->cellTable[best].Codepoint != FREE_CELL)
+        this->cache.erase(this->cellTable[best].Codepoint);
+    GlyphCell used = { codepoint, this->frame };
+    this->cellTable[best] = used;
+    return &(this->cache[codepoint] = character);
+}
+
+bool TextRenderer::rasterize(unsigned int codepoint, unsigned int cell, Character& character)
+{
+    FT_Face face = this->faces[0];
+    for (FT_Face candidate : this->faces)
+    {
+        if (FT_Get_Char_Index(candidate, codepoint) != 0)
+        {
+            face = candidate;
+            break;
+        }
+    }
+    if (codepoint >= 128 && FT_Get_Char_Index(face, codepoint) == 0)
+        return false;
+    if (FT_Load_Char(face, codepoint, this->SDF ? FT_LOAD_DEFAULT : FT_LOAD_RENDER))
+    {
+        std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+        return false;
+    }
+    // glyphs without an outline (space) have no field, they only keep their advance
+    if (this->SDF && FT_Render_Glyph(face->glyph, FT_RENDER_MODE_SDF))
+        face->glyph->bitmap.width = face->glyph->bitmap.rows = 0;
+
+    FT_Bitmap& bitmap = face->glyph->bitmap;
+    unsigned int inner = this->cellSize - 2 * GLYPH_PADDING;
+    unsigned int width = std::min(bitmap.width, inner);
+    unsigned int rows = std::min(bitmap.rows, inner);
+    // the whole cell is rewritten so an evicted glyph leaves nothing behind
+    std::vector<unsigned char> pixels(this->cellSize * this->cellSize, 0);
+    for (unsigned int row = 0; row < rows; ++row)
+        for (unsigned int col = 0; col < width; ++col)
+            pixels[(row + GLYPH_PADDING) * this->cellSize + col + GLYPH_PADDING] = bitmap.buffer[row * bitmap.pitch + col];
+
+    unsigned int x = (cell % this->cellsPerRow) * this->cellSize;
+    unsigned int y = (cell / this->cellsPerRow) * this->cellSize;
+    GLState::BindTextureForEdit(0, this->atlas);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, this->cellSize, this->cellSize, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+
+    float texel = 1.0f / this->atlasSize;
+    character.UVMin = glm::vec2(x + GLYPH_PADDING, y + GLYPH_PADDING) * texel;
+    character.UVMax = glm::vec2(x + GLYPH_PADDING + width, y + GLYPH_PADDING + rows) * texel;
+    character.Size = glm::ivec2(width, rows);
+    character.Bearing = glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top);
+    character.Advance = static_cast<unsigned int>(face->glyph->advance.x);
+    character.Cell = cell;
+    return true;
+}
+
+bool TextRenderer::openFace(const std::string& font, FT_Face& face)
+{
+    // a loose file is streamed by FreeType, only the glyph tables it touches are read;
+    // a packed font is read in place for as long as the face lives
+    if (!AssetPack::Contains(font))
+        return FT_New_Face(this->ft, font.c_str(), 0, &face) == 0;
+    AssetView data = AssetPack::Read(font);
+    if (!data || FT_New_Memory_Face(this->ft, data.Data, static_cast<FT_Long>(data.Size), 0, &face))
+        return false;
+    this->fontData.push_back(data);
+    return true;
+}
+
+void TextRenderer::releaseFonts()
+{
+    for (FT_Face face : this->faces)
+        FT_Done_Face(face);
+    this->faces.clear();
+    this->fontData.clear();
+    if (this->ft != nullptr)
+        FT_Done_FreeType(this->ft);
+    this->ft = nullptr;
+}
@@ -1,36 +1,137 @@
 #ifndef TEXT_RENDERER_H
 #define TEXT_RENDERER_H
 
-#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <ft2build.h>
+#include FT_FREETYPE_H
 
 #include "texture.h"
 #include "shader.h"
+#include "asset_pack.h"
 
 struct Character {
-    unsigned int TextureID;
+    glm::vec2    UVMin, UVMax;
     glm::ivec2   Size;
     glm::ivec2   Bearing;
     unsigned int Advance;
+    unsigned int Cell;
+};
+
+// One square of the fixed-size glyph atlas.
+struct GlyphCell {
+    unsigned int Codepoint;
+    // frame the cell was last drawn in, pinned cells are never evicted
+    unsigned int LastUsed;
+};
+
+// Retained text, laid out once and reused until its content changes.
+class TextObject
+{
+public:
+    TextObject();
+    TextObject(float x, float y, float scale = 1.0f, glm::vec3 color = glm::vec3(1.0f));
+
+    // UTF-8
+    void SetText(const char* text);
+    // prefix + value + suffix, formatted without allocating and only when value changes
+    void SetValue(const char* prefix, unsigned int value, const char* suffix = "");
+    void SetPosition(float x, float y);
+    void SetColor(glm::vec3 color);
+
+private:
+    friend class TextRenderer;
+    char text[128];
+    glm::vec2 position;
+    float scale;
+    glm::vec3 color;
+    const char* prefix;
+    const char* suffix;
+    unsigned int value;
+    bool hasValue;
+    bool dirty;
+    unsigned int version;
+    unsigned int generation;
+    std::vector<float> vertices;
+    // cached (non ASCII) glyphs the layout depends on, as (cell, codepoint)
+    std::vector<std::pair<unsigned int, unsigned int>> cells;
 };
 
 class TextRenderer
 {
 public:
-    std::map<char, Character> Characters;
+    // ASCII glyphs, pinned in the atlas at load time
+    Character Characters[128];
+    // everything else is rasterized on first use, up to this many glyphs per frame
+    unsigned int GlyphsPerFrame;
+    // signed distance field glyphs, scale freely and support the effects below
+    bool SDF;
+    glm::vec4 OutlineColor;
+    float     OutlineWidth;
+    glm::vec4 GlowColor;
+    float     GlowWidth;
 
     Shader TextShader;
 
-    TextRenderer(unsigned int width, unsigned int height);
+    TextRenderer();
+    ~TextRenderer();
 
-    void Load(std::string font, unsigned int fontSize);
+    // with sdf the glyphs are rasterized once at a fixed size and scaled to fontSize when drawn
+    void Load(std::string font, unsigned int fontSize, bool sdf = false);
+    // searched in order for codepoints the main font does not cover
+    bool AddFallbackFont(std::string font);
 
-    void RenderText(std::string text, float x, float y, float scale, glm::vec3 color = glm::vec3(1.0f));
+    // queues the UTF-8 string, nothing is drawn until Flush
+    void RenderText(const std::string& text, float x, float y, float scale, glm::vec3 color = glm::vec3(1.0f));
+
+    // queues retained text, it is only laid out again when it changed
+    void Draw(TextObject& object);
+
+    // draws every string queued this frame in one call
+    void Flush();
 
 private:
     unsigned int VAO, VBO;
+    unsigned int atlas;
+    // ATLAS_SIZE, or larger when the cells are too big for ASCII and a few cached glyphs
+    unsigned int atlasSize;
+    unsigned int cellSize, cellsPerRow;
+    std::vector<GlyphCell> cellTable;
+    std::unordered_map<unsigned int, Character> cache;
+    unsigned int frame;
+    unsigned int rasterized;
+    FT_Library ft;
+    std::vector<FT_Face> faces;
+    // the packed font files behind faces, kept alive with them
+    std::vector<AssetView> fontData;
+    unsigned int fontSize;
+    unsigned int rasterSize;
+    // rasterSize units to fontSize pixels
+    float unitScale;
+    // bearing of 'H', every glyph is aligned to it
+    int baseline;
+    // pos.xy, uv.xy, color.rgb per vertex
+    std::vector<float> vertices;
+    size_t bufferSize;
+    // bumped on Load, retained text laid out against an older atlas is stale
+    unsigned int generation;
+    // what went into the buffer last frame, an identical frame skips the upload
+    std::vector<std::pair<const TextObject*, unsigned int>> submitted, lastSubmitted;
+    bool lastHadImmediate;
+    std::vector<float> batch;
+    unsigned int vertexCount;
+
+    bool layout(const char* text, float x, float y, float scale, glm::vec3 color, std::vector<float>& out,
+        std::vector<std::pair<unsigned int, unsigned int>>* cells);
+    const Character* glyph(unsigned int codepoint);
+    bool rasterize(unsigned int codepoint, unsigned int cell, Character& character);
+    bool openFace(const std::string& font, FT_Face& face);
+    void releaseFonts();
 };
 
-#endif 
+#endif
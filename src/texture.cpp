@@ -1,27 +1,61 @@
 #include <iostream>
 
 #include "texture.h"
+#include "gl_state.h"
 
 Texture2D::Texture2D()
-    : Width(0), Height(0), Internal_Format(GL_RGB), Image_Format(GL_RGB), Wrap_S(GL_REPEAT), Wrap_T(GL_REPEAT), Filter_Min(GL_LINEAR), Filter_Max(GL_LINEAR)
+    : ID(0), Width(0), Height(0), Internal_Format(GL_RGB), Image_Format(GL_RGB), Wrap_S(GL_REPEAT), Wrap_T(GL_REPEAT), Filter_Min(GL_LINEAR), Filter_Max(GL_LINEAR)
 {
-    glGenTextures(1, &this->ID);
 }
 
 void Texture2D::Generate(unsigned int width, unsigned int height, unsigned char* data)
 {
     this->Width = width;
     this->Height = height;
-    glBindTexture(GL_TEXTURE_2D, this->ID);
+    if (this->ID == 0)
+        glGenTextures(1, &this->ID);
+    GLState::BindTextureForEdit(0, this->ID);
     glTexImage2D(GL_TEXTURE_2D, 0, this->Internal_Format, width, height, 0, this->Image_Format, GL_UNSIGNED_BYTE, data);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, this->Wrap_S);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, this->Wrap_T);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, this->Filter_Min);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, this->Filter_Max);
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void Texture2D::Bind() const
+void Texture2D::GenerateCompressed(unsigned int width, unsigned int height, GLenum format, unsigned int levels, const unsigned char* data)
 {
-    glBindTexture(GL_TEXTURE_2D, this->ID);
+    this->Width = width;
+    this->Height = height;
+    this->Internal_Format = format;
+    if (levels > 1)
+        this->Filter_Min = GL_LINEAR_MIPMAP_LINEAR;
+    if (this->ID == 0)
+        glGenTextures(1, &this->ID);
+    GLState::BindTextureForEdit(0, this->ID);
+    // with a pixel unpack buffer bound data is an offset into it
+    size_t offset = 0;
+    for (unsigned int level = 0; level < levels; ++level)
+    {
+        unsigned int size = CompressedSize(format, width, height);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, size, data + offset);
+        offset += size;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, this->Wrap_S);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, this->Wrap_T);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, this->Filter_Min);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, this->Filter_Max);
+}
+
+unsigned int Texture2D::CompressedSize(GLenum format, unsigned int width, unsigned int height)
+{
+    unsigned int blockBytes = format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+    return ((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+void Texture2D::Bind(unsigned int unit) const
+{
+    GLState::BindTexture(unit, this->ID);
 }
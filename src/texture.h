@@ -3,6 +3,10 @@
 
 #include <glad/glad.h>
 
+// S3TC formats, part of EXT_texture_compression_s3tc rather than core GL
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
 class Texture2D
 {
 public:
@@ -14,8 +18,13 @@ public:
 	unsigned int Wrap_T;
 	unsigned int Filter_Min;
 	unsigned int Filter_Max;
+	// only describes the texture, the GL name is created by the first Generate
 	Texture2D();
 	void Generate(unsigned int width, unsigned int height, unsigned char* data);
-	void Bind() const;
+	// levels are stored one after another in data, from the full size image down
+	void GenerateCompressed(unsigned int width, unsigned int height, GLenum format, unsigned int levels, const unsigned char* data);
+	// bytes a compressed level takes, DXT1 8 and DXT5 16 per 4x4 block
+	static unsigned int CompressedSize(GLenum format, unsigned int width, unsigned int height);
+	void Bind(unsigned int unit = 0) const;
 };
 #endif
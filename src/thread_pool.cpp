@@ -0,0 +1,62 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threads)
+    : running(0), quit(false)
+{
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (unsigned int i = 0; i < threads; ++i)
+        this->workers.push_back(std::thread(&ThreadPool::run, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->quit = true;
+    }
+    this->wake.notify_all();
+    for (std::thread& worker : this->workers)
+        worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back(std::move(job));
+    }
+    this->wake.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->idle.wait(lock, [this]() { return this->jobs.empty() && this->running == 0; });
+}
+
+void ThreadPool::run()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock, [this]() { return !this->jobs.empty() || this->quit; });
+            // quit only once the queue is drained
+            if (this->jobs.empty())
+                return;
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+            this->running++;
+        }
+        job();
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->running--;
+        }
+        this->idle.notify_all();
+    }
+}
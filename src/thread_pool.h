@@ -0,0 +1,36 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads taking jobs in the order they were submitted.
+// Jobs must not touch GL, only the thread that owns the context may.
+class ThreadPool
+{
+public:
+    // 0 uses one thread per core, minus the one the caller keeps busy
+    ThreadPool(unsigned int threads = 0);
+    // finishes every job already submitted
+    ~ThreadPool();
+
+    void Submit(std::function<void()> job);
+    // blocks until the queue is empty and no job is running
+    void Wait();
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    unsigned int running;
+    bool quit;
+    std::mutex mutex;
+    std::condition_variable wake, idle;
+
+    void run();
+};
+
+#endif
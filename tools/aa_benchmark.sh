@@ -0,0 +1,63 @@
+#!/bin/sh
+# Frame times of the FXAA presets against MSAA 2x/4x, from --headless runs of the game.
+#
+#   tools/aa_benchmark.sh <breakout binary> [frames] [warmup] [sizes]
+#
+# Run from the repository root, the game loads resources/ and shaders/ relative to it.
+# Every mode plays the same session: the mode keys first (M cycles MSAA 4/8/0/2,
+# F the FXAA presets), then ENTER and SPACE to launch the ball. The first warmup frames
+# hold the mode switch and the shader compiles and are left out. Prints a markdown
+# table of the mean and 95th percentile GPU and CPU milliseconds per frame.
+set -e
+
+BINARY=${1:?usage: $0 <breakout binary> [frames] [warmup] [sizes]}
+FRAMES=${2:-240}
+WARMUP=${3:-60}
+SIZES=${4:-"800x600 3840x2160"}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# <name> <keys...>: the session script for one mode, each key pressed for one frame
+script() {
+    name=$1
+    shift
+    frame=1
+    for key in "$@"; do
+        echo "$frame $key press"
+        echo "$((frame + 1)) $key release"
+        frame=$((frame + 2))
+    done > "$WORK/$name.txt"
+    cat >> "$WORK/$name.txt" <<EOF
+$((frame + 4)) ENTER press
+$((frame + 5)) ENTER release
+$((frame + 30)) SPACE press
+$((frame + 31)) SPACE release
+EOF
+}
+
+script msaa4
+script msaa2 M M M
+script off M M
+script fxaa_low M M F
+script fxaa_medium M M F F
+script fxaa_high M M F F F
+
+# <label> <timings.csv> <column>: mean and p95 of the valid times after the warmup
+stats() {
+    awk -F, -v warmup="$WARMUP" -v column="$3" 'NR > 1 && $1 >= warmup && $column >= 0 { print $column }' "$2" |
+        sort -g | awk '{ times[NR] = $1; total += $1 }
+            END { if (NR == 0) { printf "n/a | n/a"; exit }
+                  p95 = int(NR * 0.95); if (p95 < 1) p95 = 1
+                  printf "%.2f | %.2f", total / NR, times[p95] }'
+}
+
+echo "| Size | Mode | GPU mean | GPU p95 | CPU mean | CPU p95 |"
+echo "|---|---|---|---|---|---|"
+for size in $SIZES; do
+    for mode in msaa4 msaa2 off fxaa_low fxaa_medium fxaa_high; do
+        mkdir -p "$WORK/$size-$mode"
+        "$BINARY" --headless "$FRAMES" --size "$size" --script "$WORK/$mode.txt" --output "$WORK/$size-$mode" > "$WORK/$size-$mode/log.txt"
+        timings="$WORK/$size-$mode/timings.csv"
+        echo "| $size | $mode | $(stats gpu "$timings" 3) | $(stats cpu "$timings" 2) |"
+    done
+done
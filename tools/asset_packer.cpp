@@ -0,0 +1,136 @@
+// Offline asset packer: bundles directories into the single indexed file that
+// AssetPack maps at startup. Entries keep their relative path ("shaders/sprite.vs").
+//
+//   AssetPacker [--lz4] assets.pak resources shaders
+//
+// With --lz4 an entry is LZ4 compressed when that saves at least an eighth; the
+// rest (most PNG, JPG and MP3 files) stay stored and are read zero copy.
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../src/asset_pack.h"
+#include "../src/lz4_block.h"
+
+const uint64_t ENTRY_ALIGNMENT = 16;
+
+struct PackedFile {
+    std::string Path;
+    std::vector<unsigned char> Data;
+    PackRecord Record;
+};
+
+static void pad(std::ofstream& out, uint64_t& offset)
+{
+    static const char zeros[ENTRY_ALIGNMENT] = { 0 };
+    uint64_t padding = (ENTRY_ALIGNMENT - offset % ENTRY_ALIGNMENT) % ENTRY_ALIGNMENT;
+    out.write(zeros, static_cast<std::streamsize>(padding));
+    offset += padding;
+}
+
+static bool collect(const std::string& directory, std::vector<PackedFile>& files)
+{
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator iterator(directory, error);
+    if (error)
+    {
+        std::cout << "ERROR::PACK: Failed to read " << directory << std::endl;
+        return false;
+    }
+    for (const std::filesystem::directory_entry& entry : iterator)
+    {
+        if (!entry.is_regular_file())
+            continue;
+        PackedFile file;
+        file.Path = entry.path().lexically_normal().generic_string();
+        std::ifstream stream(entry.path(), std::ios::binary);
+        file.Data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        files.push_back(file);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    bool lz4 = false;
+    int first = 1;
+    if (argc > 1 && std::strcmp(argv[1], "--lz4") == 0)
+    {
+        lz4 = true;
+        first++;
+    }
+    if (argc - first < 2)
+    {
+        std::cout << "usage: AssetPacker [--lz4] <pack> <directory>..." << std::endl;
+        return 1;
+    }
+
+    std::vector<PackedFile> files;
+    for (int i = first + 1; i < argc; ++i)
+        if (!collect(argv[i], files))
+            return 1;
+    std::sort(files.begin(), files.end(), [](const PackedFile& a, const PackedFile& b) { return a.Path < b.Path; });
+
+    std::ofstream out(argv[first], std::ios::binary);
+    if (!out)
+    {
+        std::cout << "ERROR::PACK: Failed to write " << argv[first] << std::endl;
+        return 1;
+    }
+    PackHeader header = {};
+    std::memcpy(header.Magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.Version = PACK_VERSION;
+    header.Count = static_cast<uint32_t>(files.size());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t offset = sizeof(header);
+
+    uint64_t rawTotal = 0, packedTotal = 0;
+    for (PackedFile& file : files)
+    {
+        pad(out, offset);
+        file.Record.Offset = offset;
+        file.Record.RawSize = file.Data.size();
+        file.Record.Flags = 0;
+        file.Record.PathLength = static_cast<uint32_t>(file.Path.size());
+        if (lz4 && !file.Data.empty())
+        {
+            std::vector<unsigned char> compressed = LZ4Compress(file.Data.data(), file.Data.size());
+            if (compressed.size() < file.Data.size() - file.Data.size() / 8)
+            {
+                file.Data.swap(compressed);
+                file.Record.Flags |= PACK_LZ4;
+            }
+        }
+        file.Record.Size = file.Data.size();
+        out.write(reinterpret_cast<const char*>(file.Data.data()), static_cast<std::streamsize>(file.Data.size()));
+        offset += file.Data.size();
+        rawTotal += file.Record.RawSize;
+        packedTotal += file.Record.Size;
+        std::cout << file.Path << ": " << file.Record.RawSize << " -> " << file.Record.Size
+                  << (file.Record.Flags & PACK_LZ4 ? " lz4" : "") << std::endl;
+    }
+
+    pad(out, offset);
+    header.IndexOffset = offset;
+    for (const PackedFile& file : files)
+    {
+        out.write(reinterpret_cast<const char*>(&file.Record), sizeof(file.Record));
+        out.write(file.Path.data(), static_cast<std::streamsize>(file.Path.size()));
+        header.IndexSize += static_cast<uint32_t>(sizeof(file.Record) + file.Path.size());
+    }
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out)
+    {
+        std::cout << "ERROR::PACK: Failed to write " << argv[first] << std::endl;
+        return 1;
+    }
+    std::cout << files.size() << " files, " << rawTotal << " -> " << packedTotal << " bytes" << std::endl;
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Offline texture cook: turns the PNG/JPG sources into DXT compressed DDS files with
+// a full mip chain, written next to the source (block.png -> block.dds).
+// ResourceManager prefers a .dds over its source when the driver supports S3TC.
+//
+//   TextureCook resources/textures/*.png resources/textures/*.jpg
+//
+// Sources with an alpha channel become DXT5, the rest DXT1. The 64 bit FNV-1a hash of
+// the source file goes in the first reserved header words (tag "FNVH", low, high), so
+// the game can tell a stale .dds from a current one without looking at file times.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <learnOpenGL/stb_image.h>
+
+extern "C" {
+#include <image_DXT.h>
+#include <image_helper.h>
+}
+
+static unsigned int fourCC(const char* code)
+{
+    return code[0] | (code[1] << 8) | (code[2] << 16) | (code[3] << 24);
+}
+
+// same as HashBytes in src/shader.cpp, over the whole file
+static bool hashFile(const std::string& path, unsigned long long& hash)
+{
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    hash = 14695981039346656037ull;
+    unsigned char buffer[65536];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        for (size_t i = 0; i < read; ++i)
+            hash = (hash ^ buffer[i]) * 1099511628211ull;
+    std::fclose(file);
+    return true;
+}
+
+static bool cook(const std::string& source)
+{
+    int width, height, components;
+    unsigned long long hash;
+    if (!hashFile(source, hash) || !stbi_info(source.c_str(), &width, &height, &components))
+    {
+        std::cout << "ERROR::COOK: Failed to read " << source << std::endl;
+        return false;
+    }
+    bool alpha = components == 2 || components == 4;
+    int channels = alpha ? 4 : 3;
+    unsigned char* pixels = stbi_load(source.c_str(), &width, &height, &components, channels);
+    if (!pixels)
+    {
+        std::cout << "ERROR::COOK: Failed to decode " << source << std::endl;
+        return false;
+    }
+
+    // every level down to 1x1, each a box filtered half of the one before
+    std::vector<unsigned char> level(pixels, pixels + width * height * channels), smaller;
+    stbi_image_free(pixels);
+    std::vector<unsigned char> data;
+    unsigned int levels = 0, baseSize = 0;
+    int levelWidth = width, levelHeight = height;
+    while (true)
+    {
+        int size = 0;
+        unsigned char* compressed = alpha
+            ? convert_image_to_DXT5(level.data(), levelWidth, levelHeight, channels, &size)
+            : convert_image_to_DXT1(level.data(), levelWidth, levelHeight, channels, &size);
+        if (!compressed)
+        {
+            std::cout << "ERROR::COOK: Failed to compress " << source << std::endl;
+            return false;
+        }
+        data.insert(data.end(), compressed, compressed + size);
+        free(compressed);
+        if (levels++ == 0)
+            baseSize = size;
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        int nextWidth = levelWidth > 1 ? levelWidth / 2 : 1, nextHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+        smaller.resize(nextWidth * nextHeight * channels);
+        mipmap_image(level.data(), levelWidth, levelHeight, channels, smaller.data(), levelWidth > 1 ? 2 : 1, levelHeight > 1 ? 2 : 1);
+        level.swap(smaller);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    DDS_header header;
+    std::memset(&header, 0, sizeof(header));
+    header.dwMagic = fourCC("DDS ");
+    header.dwSize = 124;
+    header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.dwHeight = height;
+    header.dwWidth = width;
+    header.dwPitchOrLinearSize = baseSize;
+    header.dwMipMapCount = levels;
+    header.sPixelFormat.dwSize = 32;
+    header.sPixelFormat.dwFlags = DDPF_FOURCC;
+    header.sPixelFormat.dwFourCC = fourCC(alpha ? "DXT5" : "DXT1");
+    header.sCaps.dwCaps1 = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+    header.dwReserved1[0] = fourCC("FNVH");
+    header.dwReserved1[1] = static_cast<unsigned int>(hash);
+    header.dwReserved1[2] = static_cast<unsigned int>(hash >> 32);
+
+    std::string target = source.substr(0, source.find_last_of('.')) + ".dds";
+    FILE* file = std::fopen(target.c_str(), "wb");
+    if (!file)
+    {
+        std::cout << "ERROR::COOK: Failed to write " << target << std::endl;
+        return false;
+    }
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fwrite(data.data(), 1, data.size(), file);
+    std::fclose(file);
+    std::cout << source << " -> " << target << ": " << width << "x" << height << " " << (alpha ? "DXT5" : "DXT1")
+              << ", " << levels << " levels, " << data.size() << " bytes (" << width * height * channels << " uncompressed)" << std::endl;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: TextureCook <image> [<image> ...]" << std::endl;
+        return 1;
+    }
+    int failed = 0;
+    for (int i = 1; i < argc; ++i)
+        if (!cook(argv[i]))
+            ++failed;
+    return failed == 0 ? 0 : 1;
+}